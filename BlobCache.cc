@@ -0,0 +1,343 @@
+/*
+ * BlobCache.cc
+ *
+ */
+/*********************************************************************
+* Copyright 2018 Alan Buckley
+*
+* This file is part of japkg.
+*
+* japkg is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* japkg is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with PackIt. If not, see <http://www.gnu.org/licenses/>.
+*
+*****************************************************************************/
+
+#include "BlobCache.h"
+#include "RISCOSZipExtra.h"
+#include "Sha256.h"
+#include "tbx/path.h"
+
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+
+#define _ZIP_SYSTEM_LINUX
+#include "ziparchive/ZipArchive.h"
+#include "ziparchive/ZipException.h"
+
+BlobCache::BlobCache() :
+	_zip(nullptr),
+	_open(false),
+	_run(0),
+	_max_size(0),
+	_total_size(0),
+	_hits(0),
+	_misses(0),
+	_evicted(0)
+{
+}
+
+BlobCache::~BlobCache()
+{
+	close();
+}
+
+/**
+ * Open the cache creating it if necessary
+ *
+ * @param dirname directory holding the cache
+ * @param max_size maximum size of the compressed entries kept in bytes
+ * @returns true if the cache was opened
+ */
+bool BlobCache::open(const std::string &dirname, unsigned long long max_size)
+{
+	close();
+
+	tbx::Path(dirname).create_directory();
+	std::string zip_filename(dirname + ".Blobs");
+	_index_filename = dirname + ".Index";
+	_max_size = max_size;
+
+	_blobs.clear();
+	_total_size = 0;
+	_run = 0;
+
+	_zip = new CZipArchive();
+	bool existing = tbx::Path(zip_filename).exists();
+	try
+	{
+		if (existing)
+		{
+			_zip->Open(zip_filename.c_str(), CZipArchive::zipOpen);
+
+			std::ifstream in(_index_filename.c_str());
+			std::string line;
+			if (std::getline(in, line) && line.compare(0, 5, "Run: ") == 0)
+			{
+				std::istringstream(line.substr(5)) >> _run;
+			}
+			while (std::getline(in, line))
+			{
+				std::istringstream fields(line);
+				std::string key;
+				Blob blob;
+				if (fields >> key >> blob.size >> blob.last_used)
+				{
+					_blobs[key] = blob;
+				}
+			}
+			index_blobs();
+		} else
+		{
+			_zip->Open(zip_filename.c_str(), CZipArchive::zipCreate);
+		}
+	} catch(CZipException &e)
+	{
+		_zip->Close(CZipArchive::afAfterException);
+		// A damaged cache is deleted and started again as it only
+		// holds copies of files that can be compressed again
+		if (!existing || !recreate(zip_filename))
+		{
+			delete _zip;
+			_zip = nullptr;
+			return false;
+		}
+	}
+
+	_open = true;
+	_run++;
+
+	return true;
+}
+
+/**
+ * Set the position of each entry in the zip file so it can be used
+ * without looking it up by name.
+ *
+ * Entries in the index but not the zip file are dropped. Entries in the
+ * zip file but not the index are kept as the least recently used so they
+ * are removed first.
+ */
+void BlobCache::index_blobs()
+{
+	ZIP_INDEX_TYPE count = _zip->GetCount();
+	for (ZIP_INDEX_TYPE index = 0; index < count; index++)
+	{
+		CZipFileHeader *header = _zip->GetFileInfo(index);
+		Blob &blob = _blobs[header->GetFileName()];
+		if (blob.index < 0 && blob.last_used == 0)
+		{
+			// Not in the index
+			blob.size = header->m_uComprSize;
+		}
+		blob.index = index;
+	}
+
+	_total_size = 0;
+	for (auto blob = _blobs.begin(); blob != _blobs.end();)
+	{
+		if (blob->second.index < 0)
+		{
+			blob = _blobs.erase(blob);
+		} else
+		{
+			_total_size += blob->second.size;
+			++blob;
+		}
+	}
+}
+
+/**
+ * Delete the cache files and create a new empty cache
+ *
+ * @param zip_filename name of the zip file holding the entries
+ * @returns true if the new cache was created
+ */
+bool BlobCache::recreate(const std::string &zip_filename)
+{
+	_blobs.clear();
+	_total_size = 0;
+	_run = 0;
+	std::remove(zip_filename.c_str());
+	std::remove(_index_filename.c_str());
+
+	try
+	{
+		_zip->Open(zip_filename.c_str(), CZipArchive::zipCreate);
+	} catch(CZipException &e)
+	{
+		_zip->Close(CZipArchive::afAfterException);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Close the cache, removing least recently used entries if it is
+ * over its maximum size.
+ */
+void BlobCache::close()
+{
+	if (!_open) return;
+
+	try
+	{
+		evict();
+		_zip->Close();
+	} catch(CZipException &e)
+	{
+		_zip->Close(CZipArchive::afAfterException);
+	}
+	save_index();
+
+	delete _zip;
+	_zip = nullptr;
+	_open = false;
+}
+
+/**
+ * Create the key for a file
+ *
+ * @param filename name of file on disc
+ * @param extra RISC OS attributes of the file
+ * @param modified date stamp the file is stored with
+ * @param level compression level
+ * @param key updated with the key
+ * @returns true if the file could be read to create the key
+ */
+bool BlobCache::key(const std::string &filename, const RISCOSZipExtra &extra,
+		std::time_t modified, int level, std::string &key)
+{
+	if (!Sha256::of_file(filename, key)) return false;
+
+	std::ostringstream attrs;
+	attrs << std::hex << "-" << extra.loadaddress
+		<< "-" << extra.execaddress
+		<< "-" << extra.attributes
+		<< "-" << (unsigned long long)modified
+		<< "-" << std::dec << level;
+	key += attrs.str();
+
+	return true;
+}
+
+/**
+ * Copy a compressed file from the cache to a zip archive
+ *
+ * @param zip zip archive being created
+ * @param key key of the file
+ * @param zip_name name to give the file in the zip archive
+ * @returns true if the file was in the cache and was copied
+ */
+bool BlobCache::copy_to(CZipArchive &zip, const std::string &key, const std::string &zip_name)
+{
+	auto found = _blobs.find(key);
+	if (found != _blobs.end())
+	{
+		if (zip.GetFromArchive(*_zip, (ZIP_INDEX_TYPE)found->second.index, zip_name.c_str()))
+		{
+			found->second.last_used = _run;
+			_hits++;
+			return true;
+		}
+		// Lost from zip file
+		_total_size -= found->second.size;
+		_blobs.erase(found);
+	}
+
+	_misses++;
+	return false;
+}
+
+/**
+ * Add a compressed file to the cache
+ *
+ * @param from zip archive containing the file
+ * @param zip_name name of the file in the zip archive
+ * @param key key for the file
+ */
+void BlobCache::add(CZipArchive &from, const std::string &zip_name, const std::string &key)
+{
+	if (_blobs.find(key) != _blobs.end()) return;
+
+	ZIP_INDEX_TYPE index = from.FindFile(zip_name.c_str(), CZipArchive::ffCaseSens);
+	if (index == ZIP_FILE_INDEX_NOT_FOUND) return;
+
+	Blob blob;
+	blob.size = from.GetFileInfo(index)->m_uComprSize;
+	blob.last_used = _run;
+
+	// Files bigger than the whole cache are not worth keeping
+	if (blob.size > _max_size) return;
+
+	if (_zip->GetFromArchive(from, index, key.c_str()))
+	{
+		// Added to the end of the zip file
+		blob.index = _zip->GetCount() - 1;
+		_blobs[key] = blob;
+		_total_size += blob.size;
+	}
+}
+
+/**
+ * Remove the least recently used entries until the cache is
+ * within its maximum size
+ */
+void BlobCache::evict()
+{
+	if (_total_size <= _max_size) return;
+
+	std::vector<std::pair<unsigned int, std::string> > by_use;
+	by_use.reserve(_blobs.size());
+	for (auto &blob : _blobs) by_use.push_back(std::make_pair(blob.second.last_used, blob.first));
+	std::sort(by_use.begin(), by_use.end());
+
+	// Entries are removed in one call so the zip file is only rewritten once
+	CZipIndexesArray indexes;
+	for (auto &use : by_use)
+	{
+		if (_total_size <= _max_size) break;
+		Blob &blob = _blobs[use.second];
+		_total_size -= blob.size;
+		if (blob.index >= 0)
+		{
+			indexes.Add((ZIP_INDEX_TYPE)blob.index);
+			_evicted++;
+		}
+		_blobs.erase(use.second);
+	}
+	if (indexes.GetSize()) _zip->RemoveFiles(indexes);
+}
+
+/**
+ * Save the index of the cache entries
+ *
+ * @returns true if saved
+ */
+bool BlobCache::save_index()
+{
+	std::ofstream out(_index_filename.c_str());
+	if (!out) return false;
+
+	out << "Run: " << _run << std::endl;
+	for (auto &blob : _blobs)
+	{
+		out << blob.first << " " << blob.second.size << " " << blob.second.last_used << std::endl;
+	}
+	out.close();
+
+	return !out.fail();
+}
@@ -0,0 +1,100 @@
+/*
+ * BlobCache.h
+ *
+ */
+/*********************************************************************
+* Copyright 2018 Alan Buckley
+*
+* This file is part of japkg.
+*
+* japkg is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* japkg is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with PackIt. If not, see <http://www.gnu.org/licenses/>.
+*
+*****************************************************************************/
+
+#ifndef BLOBCACHE_H_
+#define BLOBCACHE_H_
+
+#include <string>
+#include <map>
+#include <ctime>
+
+class CZipArchive;
+class RISCOSZipExtra;
+
+/**
+ * Cache of compressed files shared between packages and runs.
+ *
+ * Compressed entries are kept in a zip file named by a key made from
+ * the SHA-256 of the file contents, its RISC OS attributes, date stamp
+ * and compression level. A file with the same key can be copied
+ * into a package without compressing it again.
+ *
+ * The cache is limited in size and the least recently used entries
+ * are removed when it is closed. A cache that can not be read is
+ * deleted and started again.
+ */
+class BlobCache
+{
+public:
+	BlobCache();
+	~BlobCache();
+
+	bool open(const std::string &dirname, unsigned long long max_size);
+	void close();
+	bool is_open() const {return _open;}
+
+	static bool key(const std::string &filename, const RISCOSZipExtra &extra,
+			std::time_t modified, int level, std::string &key);
+
+	bool copy_to(CZipArchive &zip, const std::string &key, const std::string &zip_name);
+	void add(CZipArchive &from, const std::string &zip_name, const std::string &key);
+
+	unsigned int hits() const {return _hits;}
+	unsigned int misses() const {return _misses;}
+	unsigned int evicted() const {return _evicted;}
+
+private:
+	void index_blobs();
+	bool recreate(const std::string &zip_filename);
+	void evict();
+	bool save_index();
+
+private:
+	/**
+	 * Details of an entry in the cache
+	 */
+	struct Blob
+	{
+		Blob() : size(0), last_used(0), index(-1) {}
+
+		/** Compressed size of the entry */
+		unsigned long long size;
+		/** Run the entry was last used on */
+		unsigned int last_used;
+		/** Index of the entry in the zip file, -1 if not in it */
+		int index;
+	};
+	CZipArchive *_zip;
+	bool _open;
+	std::string _index_filename;
+	std::map<std::string, Blob> _blobs;
+	unsigned int _run;
+	unsigned long long _max_size;
+	unsigned long long _total_size;
+	unsigned int _hits;
+	unsigned int _misses;
+	unsigned int _evicted;
+};
+
+#endif /* BLOBCACHE_H_ */
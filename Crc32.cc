@@ -0,0 +1,67 @@
+/*
+ * Crc32.cc
+ *
+ */
+/*********************************************************************
+* Copyright 2018 Alan Buckley
+*
+* This file is part of japkg.
+*
+* japkg is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* japkg is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with PackIt. If not, see <http://www.gnu.org/licenses/>.
+*
+*****************************************************************************/
+
+#include "Crc32.h"
+
+/**
+ * Table for the zip (reversed 0x04C11DB7) polynomial
+ */
+static unsigned int *crc_table()
+{
+	static unsigned int table[256];
+	static bool made = false;
+	if (!made)
+	{
+		for (unsigned int n = 0; n < 256; n++)
+		{
+			unsigned int c = n;
+			for (int k = 0; k < 8; k++)
+			{
+				c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+			}
+			table[n] = c;
+		}
+		made = true;
+	}
+	return table;
+}
+
+/**
+ * Add data to the CRC
+ *
+ * @param data data to add
+ * @param size size of data in bytes
+ */
+void Crc32::update(const void *data, size_t size)
+{
+	const unsigned int *table = crc_table();
+	const unsigned char *p = (const unsigned char *)data;
+	const unsigned char *end = p + size;
+	unsigned int crc = _crc;
+	while (p != end)
+	{
+		crc = table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+	}
+	_crc = crc;
+}
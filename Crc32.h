@@ -0,0 +1,51 @@
+/*
+ * Crc32.h
+ *
+ */
+/*********************************************************************
+* Copyright 2018 Alan Buckley
+*
+* This file is part of japkg.
+*
+* japkg is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* japkg is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with PackIt. If not, see <http://www.gnu.org/licenses/>.
+*
+*****************************************************************************/
+
+#ifndef CRC32_H_
+#define CRC32_H_
+
+#include <cstddef>
+#include <string>
+
+/**
+ * Calculate the CRC-32 used in zip files
+ */
+class Crc32
+{
+public:
+	Crc32() : _crc(0xFFFFFFFF) {}
+
+	void update(const void *data, size_t size);
+	void update(const std::string &text) {update(text.data(), text.size());}
+
+	/** Return the CRC of all the data so far */
+	unsigned int value() const {return _crc ^ 0xFFFFFFFF;}
+
+	static unsigned int of(const std::string &text) {Crc32 crc; crc.update(text); return crc.value();}
+
+private:
+	unsigned int _crc;
+};
+
+#endif /* CRC32_H_ */
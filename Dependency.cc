@@ -0,0 +1,189 @@
+/*
+ * Dependency.cc
+ *
+ */
+/*********************************************************************
+* Copyright 2018 Alan Buckley
+*
+* This file is part of japkg.
+*
+* japkg is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* japkg is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with PackIt. If not, see <http://www.gnu.org/licenses/>.
+*
+*****************************************************************************/
+
+#include "Dependency.h"
+
+/**
+ * Check if a package version satisfies this dependency
+ *
+ * @param pkg_version version of the package named by the dependency
+ * @returns true if the version is acceptable
+ */
+bool Dependency::satisfied_by(const pkg::version &pkg_version) const
+{
+	switch(op)
+	{
+	case NONE: return true;
+	case LESS: return pkg_version < version;
+	case LESS_EQUAL: return pkg_version <= version;
+	case EQUAL: return pkg_version == version;
+	case GREATER_EQUAL: return pkg_version >= version;
+	case GREATER: return pkg_version > version;
+	}
+	return false;
+}
+
+/**
+ * Return the dependency as it would be written in a control record
+ */
+std::string Dependency::text() const
+{
+	if (op == NONE) return name;
+	return name + " (" + operator_text(op) + " " + std::string(version) + ")";
+}
+
+/**
+ * Return the text used in a control record for an operator
+ */
+const char *Dependency::operator_text(Operator op)
+{
+	switch(op)
+	{
+	case NONE: break;
+	case LESS: return "<<";
+	case LESS_EQUAL: return "<=";
+	case EQUAL: return "=";
+	case GREATER_EQUAL: return ">=";
+	case GREATER: return ">>";
+	}
+	return "";
+}
+
+/**
+ * Parse a comma separated list of dependencies
+ *
+ * @param text text of the field from the control record
+ * @param list vector to fill with the dependencies.
+ * It is left empty if there is an error.
+ * @returns empty string if the list is valid, otherwise a description of
+ * the first problem found.
+ */
+std::string Dependency::parse_list(const std::string &text, std::vector<Dependency> &list)
+{
+	list.clear();
+	if (text.empty()) return std::string(); // Don't need to have a dependency
+
+	std::string err;
+	std::string::const_iterator start = text.begin();
+	std::string::const_iterator comma;
+	do
+	{
+		comma = start;
+		while (comma != text.end() && *comma != ',') ++comma;
+		list.push_back(Dependency());
+		err = parse(start, comma, list.back());
+		if (comma != text.end()) start = comma + 1;
+	} while (comma != text.end() && err.empty());
+
+	if (!err.empty()) list.clear();
+
+	return err;
+}
+
+/**
+ * Return a list of dependencies as a comma separated list
+ */
+std::string Dependency::list_text(const std::vector<Dependency> &list)
+{
+	std::string text;
+	for (const Dependency &dep : list)
+	{
+		if (!text.empty()) text += ", ";
+		text += dep.text();
+	}
+	return text;
+}
+
+/**
+ * Parse a single dependency
+ *
+ * @param i start of the dependency text
+ * @param end end of the dependency text
+ * @param dep dependency to update
+ * @returns empty string if the dependency is valid, otherwise a description
+ * of the problem
+ */
+std::string Dependency::parse(std::string::const_iterator i, std::string::const_iterator end, Dependency &dep)
+{
+	while (i != end && (*i) == ' ') i++;
+	if (i == end) return "empty dependency, have you got too many commas";
+	if ((*i) == ')') return "Extra ')' in a dependency";
+
+	std::string::const_iterator name_start = i;
+	while (i != end && (*i) != '(' && (*i) != ' ') i++;
+	dep.name.assign(name_start, i);
+
+	while (i != end && (*i) == ' ') i++;
+	if (i == end) return std::string();
+	if (*i != '(') return "dependency package name must end with a comma or a '('";
+
+	i++;
+	while (i != end && (*i) == ' ') i++;
+	if (i == end || !((*i) == '=' || (*i) == '<' || (*i) == '>'))
+	{
+		return "version operator '=', '<<', '>>', '<=' or '>=' missing";
+	}
+
+	if ((*i) == '<')
+	{
+		i++;
+		if (i == end || ((*i) != '<' && (*i) != '='))
+		{
+			return "'<' must be followed by another '<' or and '='";
+		}
+		dep.op = ((*i) == '<') ? LESS : LESS_EQUAL;
+	} else if ((*i) == '>')
+	{
+		i++;
+		if (i == end || ((*i) != '>' && (*i) != '='))
+		{
+			return "'>' must be followed by another '>' or and '='";
+		}
+		dep.op = ((*i) == '>') ? GREATER : GREATER_EQUAL;
+	} else
+	{
+		dep.op = EQUAL;
+	}
+
+	i++;
+	while (i != end && (*i) == ' ') i++;
+	if (i == end || (*i) == ')' || (*i) == ',') return "version number missing";
+	if ((*i) == '>' || (*i) == '<' || (*i) == '=') return "extra symbol in version operator";
+
+	std::string::const_iterator version_start = i;
+	while (i != end && *i != ')' && (*i) != ' ') i++;
+	std::string::const_iterator version_end = i;
+	while (i != end && *i == ' ') i++;
+	if (i == end || *i != ')') return "missing ')' or a space in the version number";
+
+	try
+	{
+		dep.version = pkg::version(version_start, version_end);
+	} catch(pkg::version::parse_error &e)
+	{
+		return std::string("version number has an ") + e.what();
+	}
+
+	return std::string();
+}
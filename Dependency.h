@@ -0,0 +1,63 @@
+/*
+ * Dependency.h
+ *
+ */
+/*********************************************************************
+* Copyright 2018 Alan Buckley
+*
+* This file is part of japkg.
+*
+* japkg is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* japkg is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with PackIt. If not, see <http://www.gnu.org/licenses/>.
+*
+*****************************************************************************/
+
+#ifndef DEPENDENCY_H_
+#define DEPENDENCY_H_
+
+#include <string>
+#include <vector>
+#include "version.h"
+
+/**
+ * A single dependency on another package parsed from
+ * a Depends, Recommends, Suggests or Conflicts field
+ */
+class Dependency
+{
+public:
+	/** Version relationship, NONE if any version will do */
+	enum Operator {NONE, LESS, LESS_EQUAL, EQUAL, GREATER_EQUAL, GREATER};
+
+	Dependency() : op(NONE) {}
+
+	/** Name of the package depended on */
+	std::string name;
+	/** Relation the version must have to the package version */
+	Operator op;
+	/** Version to compare with, only valid if op is not NONE */
+	pkg::version version;
+
+	bool satisfied_by(const pkg::version &pkg_version) const;
+	std::string text() const;
+
+	static const char *operator_text(Operator op);
+
+	static std::string parse_list(const std::string &text, std::vector<Dependency> &list);
+	static std::string list_text(const std::vector<Dependency> &list);
+
+private:
+	static std::string parse(std::string::const_iterator i, std::string::const_iterator end, Dependency &dep);
+};
+
+#endif /* DEPENDENCY_H_ */
@@ -0,0 +1,248 @@
+/*
+ * DependencyGraph.cc
+ *
+ */
+/*********************************************************************
+* Copyright 2018 Alan Buckley
+*
+* This file is part of japkg.
+*
+* japkg is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* japkg is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with PackIt. If not, see <http://www.gnu.org/licenses/>.
+*
+*****************************************************************************/
+
+#include "DependencyGraph.h"
+
+DependencyGraph::DependencyGraph() :
+	_depends_changed(false)
+{
+}
+
+/**
+ * Add a package where only the version is known.
+ *
+ * If the package is already in the graph only its version is updated.
+ *
+ * @param name package name
+ * @param version package version
+ */
+void DependencyGraph::add(const std::string &name, const std::string &version)
+{
+	set_version(name, version);
+}
+
+/**
+ * Add or replace a package and the packages it depends on
+ *
+ * @param name package name
+ * @param version package version
+ * @param depends packages it depends on
+ */
+void DependencyGraph::add(const std::string &name, const std::string &version, const std::vector<Dependency> &depends)
+{
+	Node &node = set_version(name, version);
+
+	for (const Dependency &dep : node.depends)
+	{
+		auto found = _dependents.find(dep.name);
+		if (found != _dependents.end()) found->second.erase(name);
+	}
+	node.depends = depends;
+	for (const Dependency &dep : node.depends)
+	{
+		_dependents[dep.name].insert(name);
+	}
+	node.dirty = true;
+	_depends_changed = true;
+}
+
+/**
+ * Set the version of a package, adding it if necessary, and mark
+ * the packages that depend on it to be checked again if it
+ * has changed.
+ *
+ * @returns node for the package
+ */
+DependencyGraph::Node &DependencyGraph::set_version(const std::string &name, const std::string &version)
+{
+	auto found = _nodes.find(name);
+	if (found == _nodes.end())
+	{
+		found = _nodes.insert(std::make_pair(name, Node())).first;
+		_depends_changed = true; // Dependency on it may now be satisfied
+	} else if (found->second.version_text == version)
+	{
+		return found->second;
+	}
+
+	Node &node = found->second;
+	node.version_text = version;
+	try
+	{
+		node.version = pkg::version(version);
+		node.version_ok = true;
+	} catch(pkg::version::parse_error &)
+	{
+		node.version_ok = false;
+	}
+	node.dirty = true;
+	mark_dependents(name);
+
+	return node;
+}
+
+/**
+ * Mark the packages that depend on a package to be checked again
+ */
+void DependencyGraph::mark_dependents(const std::string &name)
+{
+	auto found = _dependents.find(name);
+	if (found == _dependents.end()) return;
+	for (const std::string &dependent : found->second)
+	{
+		auto node = _nodes.find(dependent);
+		if (node != _nodes.end()) node->second.dirty = true;
+	}
+}
+
+/**
+ * Check the packages added or affected by changes since the last check
+ *
+ * @param problems vector updated with a description of each problem found
+ * @returns number of problems found
+ */
+size_t DependencyGraph::check(std::vector<std::string> &problems)
+{
+	problems.clear();
+	for (NodeMap::iterator it = _nodes.begin(); it != _nodes.end(); ++it)
+	{
+		if (it->second.dirty) check_node(it->first, it->second);
+		problems.insert(problems.end(), it->second.problems.begin(), it->second.problems.end());
+	}
+
+	if (_depends_changed) find_cycles();
+	problems.insert(problems.end(), _cycles.begin(), _cycles.end());
+
+	return problems.size();
+}
+
+/**
+ * Check the dependencies of one package can be satisfied
+ */
+void DependencyGraph::check_node(const std::string &name, Node &node)
+{
+	node.problems.clear();
+	node.dirty = false;
+	for (const Dependency &dep : node.depends)
+	{
+		auto target = _nodes.find(dep.name);
+		if (target == _nodes.end())
+		{
+			node.problems.push_back(name + " depends on " + dep.text() + " which is not a package");
+		} else if (dep.op != Dependency::NONE)
+		{
+			const Node &found = target->second;
+			if (!found.version_ok)
+			{
+				node.problems.push_back(name + " depends on " + dep.text() + " but the version " + found.version_text + " can not be compared");
+			} else if (!dep.satisfied_by(found.version))
+			{
+				node.problems.push_back(name + " depends on " + dep.text() + " but the version is " + found.version_text);
+			}
+		}
+	}
+}
+
+/**
+ * Find groups of packages that depend on each other using
+ * Tarjan's strongly connected components algorithm.
+ */
+void DependencyGraph::find_cycles()
+{
+	_cycles.clear();
+	_depends_changed = false;
+
+	for (NodeMap::iterator it = _nodes.begin(); it != _nodes.end(); ++it)
+	{
+		it->second.index = 0;
+		it->second.on_stack = false;
+	}
+
+	unsigned int next_index = 1;
+	std::vector<NodeMap::iterator> stack;
+	for (NodeMap::iterator it = _nodes.begin(); it != _nodes.end(); ++it)
+	{
+		if (it->second.index == 0) connect(it, next_index, stack);
+	}
+}
+
+/**
+ * Visit a package for find_cycles
+ *
+ * @param it package to visit
+ * @param next_index next index to allocate
+ * @param stack packages visited and not yet assigned to a component
+ */
+void DependencyGraph::connect(NodeMap::iterator it, unsigned int &next_index, std::vector<NodeMap::iterator> &stack)
+{
+	Node &node = it->second;
+	node.index = node.low_link = next_index++;
+	stack.push_back(it);
+	node.on_stack = true;
+	bool self_dependent = false;
+
+	for (const Dependency &dep : node.depends)
+	{
+		NodeMap::iterator target = _nodes.find(dep.name);
+		if (target == _nodes.end()) continue;
+		if (target == it) self_dependent = true;
+
+		Node &next = target->second;
+		if (next.index == 0)
+		{
+			connect(target, next_index, stack);
+			if (next.low_link < node.low_link) node.low_link = next.low_link;
+		} else if (next.on_stack && next.index < node.low_link)
+		{
+			node.low_link = next.index;
+		}
+	}
+
+	if (node.low_link == node.index)
+	{
+		std::vector<std::string> names;
+		NodeMap::iterator member;
+		do
+		{
+			member = stack.back();
+			stack.pop_back();
+			member->second.on_stack = false;
+			names.push_back(member->first);
+		} while (member != it);
+
+		if (names.size() == 1)
+		{
+			if (self_dependent) _cycles.push_back(names.front() + " depends on itself");
+		} else
+		{
+			std::string cycle("Dependency cycle between ");
+			for (std::vector<std::string>::reverse_iterator name = names.rbegin(); name != names.rend(); ++name)
+			{
+				if (name != names.rbegin()) cycle += ", ";
+				cycle += *name;
+			}
+			_cycles.push_back(cycle);
+		}
+	}
+}
@@ -0,0 +1,91 @@
+/*
+ * DependencyGraph.h
+ *
+ */
+/*********************************************************************
+* Copyright 2018 Alan Buckley
+*
+* This file is part of japkg.
+*
+* japkg is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* japkg is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with PackIt. If not, see <http://www.gnu.org/licenses/>.
+*
+*****************************************************************************/
+
+#ifndef DEPENDENCYGRAPH_H_
+#define DEPENDENCYGRAPH_H_
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include "Dependency.h"
+
+/**
+ * Graph of the dependencies between all the packages in a run.
+ *
+ * Packages are added with their version and the packages they
+ * depend on. check then reports dependencies on packages that
+ * do not exist, dependencies that the version of the package
+ * can not satisfy and packages that depend on each other.
+ *
+ * Adding a package again only causes it and the packages that
+ * depend on it to be checked again.
+ */
+class DependencyGraph
+{
+public:
+	DependencyGraph();
+
+	void add(const std::string &name, const std::string &version);
+	void add(const std::string &name, const std::string &version, const std::vector<Dependency> &depends);
+
+	size_t check(std::vector<std::string> &problems);
+	size_t size() const {return _nodes.size();}
+
+private:
+	/**
+	 * A package in the graph
+	 */
+	struct Node
+	{
+		Node() : version_ok(false), dirty(true), index(0), low_link(0), on_stack(false) {}
+
+		std::string version_text;
+		pkg::version version;
+		bool version_ok;
+		std::vector<Dependency> depends;
+		std::vector<std::string> problems;
+		bool dirty;
+		// Used when finding cycles
+		unsigned int index;
+		unsigned int low_link;
+		bool on_stack;
+	};
+	typedef std::map<std::string, Node> NodeMap;
+
+	Node &set_version(const std::string &name, const std::string &version);
+	void mark_dependents(const std::string &name);
+	void check_node(const std::string &name, Node &node);
+	void find_cycles();
+	void connect(NodeMap::iterator it, unsigned int &next_index, std::vector<NodeMap::iterator> &stack);
+
+private:
+	NodeMap _nodes;
+	/** Packages that depend on each package name */
+	std::map<std::string, std::set<std::string> > _dependents;
+	std::vector<std::string> _cycles;
+	bool _depends_changed;
+};
+
+#endif /* DEPENDENCYGRAPH_H_ */
@@ -0,0 +1,188 @@
+/*
+ * DigestZipFile.cc
+ *
+ */
+/*********************************************************************
+* Copyright 2018 Alan Buckley
+*
+* This file is part of japkg.
+*
+* japkg is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* japkg is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with PackIt. If not, see <http://www.gnu.org/licenses/>.
+*
+*****************************************************************************/
+
+#include "DigestZipFile.h"
+#include <algorithm>
+#include <cstring>
+
+/**
+ * Construct the file
+ *
+ * @param output file to pass the data on to or nullptr to discard it
+ */
+DigestZipFile::DigestZipFile(CZipAbstractFile *output /*= nullptr*/) :
+	_output(output),
+	_position(0),
+	_length(0),
+	_committed(0),
+	_valid(true),
+	_closed(false)
+{
+}
+
+/**
+ * Add the data written since the last commit to the digest.
+ *
+ * Called when an entry has been completed so the data will not be
+ * changed again.
+ */
+void DigestZipFile::commit()
+{
+	if (_pending.empty()) return;
+	_md5.update(_pending);
+	_sha256.update(_pending);
+	_committed += _pending.size();
+	_pending.clear();
+}
+
+/**
+ * Return the MD5 digest of the file.
+ *
+ * This commits any outstanding data so should only be called once
+ * the file is complete.
+ *
+ * @returns MD5 digest in hexadecimal
+ */
+std::string DigestZipFile::md5_digest()
+{
+	commit();
+	return _md5.hex_digest();
+}
+
+/**
+ * Return the SHA-256 digest of the file.
+ *
+ * This commits any outstanding data so should only be called once
+ * the file is complete.
+ *
+ * @returns SHA-256 digest in hexadecimal
+ */
+std::string DigestZipFile::sha256_digest()
+{
+	commit();
+	return _sha256.hex_digest();
+}
+
+void DigestZipFile::Close()
+{
+	if (_closed) return;
+	commit();
+	if (_output) _output->Close();
+	_closed = true;
+}
+
+void DigestZipFile::Flush()
+{
+	if (_output) _output->Flush();
+}
+
+ZIP_FILE_USIZE DigestZipFile::Seek(ZIP_FILE_SIZE lOff, int nFrom)
+{
+	ZIP_FILE_SIZE from = 0;
+	if (nFrom == current) from = (ZIP_FILE_SIZE)_position;
+	else if (nFrom == end) from = (ZIP_FILE_SIZE)_length;
+
+	if (lOff < -from)
+	{
+		_valid = false;
+		lOff = -from;
+	}
+	_position = (ZIP_FILE_USIZE)(from + lOff);
+	if (_output) _output->Seek((ZIP_FILE_SIZE)_position, begin);
+
+	return _position;
+}
+
+void DigestZipFile::SetLength(ZIP_FILE_USIZE nNewLen)
+{
+	if (_output) _output->SetLength(nNewLen);
+	if (nNewLen < _committed)
+	{
+		// Data already in the digest has been removed
+		_valid = false;
+		_committed = nNewLen;
+		_pending.clear();
+	} else
+	{
+		_pending.resize((std::size_t)(nNewLen - _committed), '\0');
+	}
+	_length = nNewLen;
+}
+
+CZipString DigestZipFile::GetFilePath() const
+{
+	return _output ? _output->GetFilePath() : CZipString();
+}
+
+bool DigestZipFile::HasFilePath() const
+{
+	return _output && _output->HasFilePath();
+}
+
+UINT DigestZipFile::Read(void *lpBuf, UINT nCount)
+{
+	UINT got = 0;
+	if (_output)
+	{
+		got = _output->Read(lpBuf, nCount);
+	} else if (_position >= _committed)
+	{
+		// Only data that has not been committed is still available
+		if (_position < _length)
+		{
+			got = (UINT)std::min<ZIP_FILE_USIZE>(nCount, _length - _position);
+			std::memcpy(lpBuf, _pending.data() + (_position - _committed), got);
+		}
+	} else
+	{
+		_valid = false;
+	}
+	_position += got;
+
+	return got;
+}
+
+void DigestZipFile::Write(const void *lpBuf, UINT nCount)
+{
+	if (_output) _output->Write(lpBuf, nCount);
+
+	const char *data = static_cast<const char *>(lpBuf);
+	ZIP_FILE_USIZE end_pos = _position + nCount;
+	if (_position < _committed)
+	{
+		// Data already in the digest has been changed
+		_valid = false;
+		UINT skip = (UINT)std::min<ZIP_FILE_USIZE>(_committed - _position, nCount);
+		data += skip;
+		nCount -= skip;
+	}
+	if (nCount)
+	{
+		std::size_t offset = (std::size_t)(end_pos - nCount - _committed);
+		if (offset > _pending.size()) _pending.resize(offset, '\0');
+		_pending.replace(offset, nCount, data, nCount);
+	}
+	_position = end_pos;
+	if (_position > _length) _length = _position;
+}
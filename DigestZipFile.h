@@ -0,0 +1,82 @@
+/*
+ * DigestZipFile.h
+ *
+ */
+/*********************************************************************
+* Copyright 2018 Alan Buckley
+*
+* This file is part of japkg.
+*
+* japkg is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* japkg is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with PackIt. If not, see <http://www.gnu.org/licenses/>.
+*
+*****************************************************************************/
+
+#ifndef DIGESTZIPFILE_H_
+#define DIGESTZIPFILE_H_
+
+#include <string>
+#include "ziparchive/ZipArchive.h"
+#include "Md5.h"
+#include "Sha256.h"
+
+/**
+ * Zip file that calculates the digests of the data written to it.
+ *
+ * The data is passed on to an optional output file. Without one the
+ * data is discarded once it has been added to the digest so memory use
+ * does not grow with the size of the package.
+ *
+ * The zip archive goes back to update the local header of an entry
+ * once the entry has been written so data is only added to the digest
+ * when commit is called after each entry. Any write before the last
+ * commit makes the digest invalid.
+ */
+class DigestZipFile : public CZipAbstractFile
+{
+public:
+	DigestZipFile(CZipAbstractFile *output = nullptr);
+
+	void commit();
+
+	/** Return true if every byte written has been included in the digest */
+	bool valid() const {return _valid;}
+
+	std::string md5_digest();
+	std::string sha256_digest();
+
+	void Close();
+	void Flush();
+	ZIP_FILE_USIZE GetPosition() const {return _position;}
+	ZIP_FILE_USIZE Seek(ZIP_FILE_SIZE lOff, int nFrom);
+	ZIP_FILE_USIZE GetLength() const {return _length;}
+	void SetLength(ZIP_FILE_USIZE nNewLen);
+	CZipString GetFilePath() const;
+	bool HasFilePath() const;
+	UINT Read(void *lpBuf, UINT nCount);
+	void Write(const void *lpBuf, UINT nCount);
+	bool IsClosed() const {return _closed;}
+
+private:
+	CZipAbstractFile *_output;
+	ZIP_FILE_USIZE _position;
+	ZIP_FILE_USIZE _length;
+	ZIP_FILE_USIZE _committed;
+	std::string _pending;
+	Md5 _md5;
+	Sha256 _sha256;
+	bool _valid;
+	bool _closed;
+};
+
+#endif /* DIGESTZIPFILE_H_ */
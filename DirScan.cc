@@ -0,0 +1,101 @@
+/*
+ * DirScan.cc
+ *
+ */
+/*********************************************************************
+* Copyright 2018 Alan Buckley
+*
+* This file is part of japkg.
+*
+* japkg is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* japkg is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with PackIt. If not, see <http://www.gnu.org/licenses/>.
+*
+*****************************************************************************/
+
+#include "DirScan.h"
+#include <cstring>
+#include <swis.h>
+
+/**
+ * Start scan of a directory
+ *
+ * @param dirname RISC OS name of directory to scan
+ * @param buffer_size size of buffer to read entries into
+ */
+DirScan::DirScan(const std::string &dirname, int buffer_size /*= 16384*/) :
+	_dirname(dirname),
+	_buffer(new char[buffer_size]),
+	_buffer_size(buffer_size),
+	_entry(nullptr),
+	_left_in_batch(0),
+	_offset(0),
+	_error(false)
+{
+}
+
+DirScan::~DirScan()
+{
+	delete [] _buffer;
+}
+
+/**
+ * Move to the next entry in the directory
+ *
+ * @returns true if there is an entry, false at the end of the directory
+ */
+bool DirScan::next()
+{
+	if (_left_in_batch > 0)
+	{
+		// Records are word aligned
+		const char *name_end = name() + std::strlen(name()) + 1;
+		_entry += ((name_end - _entry) + 3) & ~3;
+	}
+
+	while (_left_in_batch == 0)
+	{
+		if (!read_batch()) return false;
+	}
+
+	_left_in_batch--;
+	return true;
+}
+
+/**
+ * Read the next batch of entries with OS_GBPB 10
+ *
+ * @returns false if there are no more entries or there was an error
+ */
+bool DirScan::read_batch()
+{
+	if (_offset == -1 || _error) return false;
+
+	int read_count = 0;
+	int next_offset = -1;
+	if (_swix(OS_GBPB, _INR(0,6)|_OUTR(3,4),
+			10, _dirname.c_str(), _buffer,
+			_buffer_size / 24, // Max entries, stops early if buffer fills
+			_offset, _buffer_size, "*",
+			&read_count, &next_offset) != nullptr)
+	{
+		_error = true;
+		return false;
+	}
+
+	_offset = next_offset;
+	_left_in_batch = read_count;
+	_entry = _buffer;
+
+	// Can return 0 entries before the end of the directory
+	return (read_count > 0 || _offset != -1);
+}
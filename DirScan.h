@@ -0,0 +1,84 @@
+/*
+ * DirScan.h
+ *
+ */
+/*********************************************************************
+* Copyright 2018 Alan Buckley
+*
+* This file is part of japkg.
+*
+* japkg is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* japkg is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with PackIt. If not, see <http://www.gnu.org/licenses/>.
+*
+*****************************************************************************/
+
+#ifndef DIRSCAN_H_
+#define DIRSCAN_H_
+
+#include <string>
+
+/**
+ * Class to read the catalogue information for a directory in
+ * large batches.
+ *
+ * Each call to the filing system returns as many entries as will
+ * fit in the buffer, including the load/exec address, length,
+ * attributes and object type so no further calls are needed
+ * to find out about an object.
+ *
+ * Usage:
+ *   DirScan scan(dirname);
+ *   while (scan.next()) { ... scan.name() ... }
+ */
+class DirScan
+{
+public:
+	/**
+	 * Object types returned by the filing system
+	 */
+	enum ObjectType {OT_NOT_FOUND = 0, OT_FILE = 1, OT_DIRECTORY = 2, OT_IMAGE_FILE = 3};
+
+	DirScan(const std::string &dirname, int buffer_size = 16384);
+	~DirScan();
+	// Owns its buffer so can't be copied
+	DirScan(const DirScan &) = delete;
+	DirScan &operator=(const DirScan &) = delete;
+
+	bool next();
+
+	/** true if the directory could not be read */
+	bool error() const {return _error;}
+
+	const char *name() const {return _entry + 20;}
+	unsigned int load_address() const {return entry_word(0);}
+	unsigned int exec_address() const {return entry_word(1);}
+	unsigned int length() const {return entry_word(2);}
+	unsigned int attributes() const {return entry_word(3);}
+	ObjectType object_type() const {return ObjectType(entry_word(4));}
+	bool directory() const {return object_type() == OT_DIRECTORY;}
+
+private:
+	unsigned int entry_word(int i) const {return ((const unsigned int *)_entry)[i];}
+	bool read_batch();
+
+private:
+	std::string _dirname;
+	char *_buffer;
+	int _buffer_size;
+	const char *_entry;
+	int _left_in_batch;
+	int _offset;
+	bool _error;
+};
+
+#endif /* DIRSCAN_H_ */
@@ -0,0 +1,44 @@
+/*
+ * Fnv64.cc
+ *
+ */
+/*********************************************************************
+* Copyright 2018 Alan Buckley
+*
+* This file is part of japkg.
+*
+* japkg is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* japkg is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with PackIt. If not, see <http://www.gnu.org/licenses/>.
+*
+*****************************************************************************/
+
+#include "Fnv64.h"
+
+/**
+ * Add data to the hash
+ *
+ * @param data data to add
+ * @param size size of data in bytes
+ */
+void Fnv64::update(const void *data, size_t size)
+{
+	const unsigned char *p = static_cast<const unsigned char *>(data);
+	const unsigned char *end = p + size;
+	unsigned long long hash = _hash;
+	while (p != end)
+	{
+		hash ^= *p++;
+		hash *= 1099511628211ULL;
+	}
+	_hash = hash;
+}
@@ -0,0 +1,51 @@
+/*
+ * Fnv64.h
+ *
+ */
+/*********************************************************************
+* Copyright 2018 Alan Buckley
+*
+* This file is part of japkg.
+*
+* japkg is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* japkg is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with PackIt. If not, see <http://www.gnu.org/licenses/>.
+*
+*****************************************************************************/
+
+#ifndef FNV64_H_
+#define FNV64_H_
+
+#include <cstddef>
+#include <string>
+
+/**
+ * Calculate the 64 bit FNV-1a hash used to fingerprint text
+ */
+class Fnv64
+{
+public:
+	Fnv64() : _hash(14695981039346656037ULL) {}
+
+	void update(const void *data, size_t size);
+	void update(const std::string &text) {update(text.data(), text.size());}
+
+	/** Return the hash of all the data so far */
+	unsigned long long value() const {return _hash;}
+
+	static unsigned long long of(const std::string &text) {Fnv64 fnv; fnv.update(text); return fnv.value();}
+
+private:
+	unsigned long long _hash;
+};
+
+#endif /* FNV64_H_ */
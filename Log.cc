@@ -27,7 +27,12 @@
 #include "Log.h"
 #include <ctime>
 
-Log::Log() : _unchanged(0) {
+Log::Log() : _unchanged(0),
+	_cache_used(false),
+	_cache_hits(0),
+	_cache_misses(0),
+	_cache_evicted(0)
+{
 }
 
 Log::~Log()
@@ -91,6 +96,14 @@ void Log::end(const std::string &msg)
 	sum << "Total                " << (_new_packages.size() + _upgrade_packages.size()
 			+ _error_packages.size() + _unchanged) << std::endl;
 	sum << std::endl;
+	if (_cache_used)
+	{
+		sum << "Compressed file cache" << std::endl;
+		sum << "  Hits               " << _cache_hits << std::endl;
+		sum << "  Misses             " << _cache_misses << std::endl;
+		sum << "  Evicted            " << _cache_evicted << std::endl;
+		sum << std::endl;
+	}
     if (!_new_packages.empty())
     {
     	sum << std::endl;
@@ -153,6 +166,20 @@ void Log::fatal_error(const std::string &msg)
 }
 
 
+/**
+ * Set the statistics for the compressed file cache to show in the summary
+ */
+void Log::cache_statistics(size_t hits, size_t misses, size_t evicted)
+{
+	_cache_used = true;
+	_cache_hits = hits;
+	_cache_misses = misses;
+	_cache_evicted = evicted;
+	log_time();
+	_log_file << ":INFO:Compressed file cache " << hits << " hits, "
+			<< misses << " misses, " << evicted << " evicted" << std::endl;
+}
+
 void Log::new_package(const std::string &full_title)
 {
 	_new_packages.push_back(full_title);
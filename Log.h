@@ -71,6 +71,7 @@ public:
     void upgrade_package(const std::string &full_title);
     void error_package(const std::string &full_title);
     void inc_unchanged() {_unchanged++;}
+    void cache_statistics(size_t hits, size_t misses, size_t evicted);
 
 private:
     void log_time();
@@ -83,6 +84,10 @@ private:
     std::vector<std::string> _upgrade_packages;
     std::vector<std::string> _error_packages;
     size_t _unchanged;
+    bool _cache_used;
+    size_t _cache_hits;
+    size_t _cache_misses;
+    size_t _cache_evicted;
 };
 
 #endif /* LOG_H_ */
@@ -0,0 +1,181 @@
+/*
+ * Md5.cc
+ *
+ */
+/*********************************************************************
+* Copyright 2018 Alan Buckley
+*
+* This file is part of japkg.
+*
+* japkg is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* japkg is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with PackIt. If not, see <http://www.gnu.org/licenses/>.
+*
+*****************************************************************************/
+
+#include "Md5.h"
+#include <cstring>
+
+/** Per round shift amounts */
+static const int s[64] =
+{
+	7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+	5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20,
+	4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+	6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+};
+
+/** Integer part of abs(sin(i+1)) * 2^32 */
+static const unsigned int k[64] =
+{
+	0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+	0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+	0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+	0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+	0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+	0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+	0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+	0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+static inline unsigned int rotl(unsigned int x, int n)
+{
+	return (x << n) | (x >> (32 - n));
+}
+
+Md5::Md5() :
+	_length(0),
+	_used(0)
+{
+	_state[0] = 0x67452301;
+	_state[1] = 0xefcdab89;
+	_state[2] = 0x98badcfe;
+	_state[3] = 0x10325476;
+}
+
+/**
+ * Add data to the digest
+ *
+ * @param data data to add
+ * @param size size of data in bytes
+ */
+void Md5::update(const void *data, size_t size)
+{
+	const unsigned char *p = (const unsigned char *)data;
+	_length += size;
+
+	if (_used)
+	{
+		size_t fill = 64 - _used;
+		if (fill > size) fill = size;
+		std::memcpy(_block + _used, p, fill);
+		_used += fill;
+		p += fill;
+		size -= fill;
+		if (_used < 64) return;
+		transform(_block);
+		_used = 0;
+	}
+
+	while (size >= 64)
+	{
+		transform(p);
+		p += 64;
+		size -= 64;
+	}
+
+	if (size)
+	{
+		std::memcpy(_block, p, size);
+		_used = size;
+	}
+}
+
+/**
+ * Finish the digest and return it as lower case hexadecimal.
+ *
+ * No more data can be added after this has been called.
+ */
+std::string Md5::hex_digest()
+{
+	unsigned long long bits = _length * 8;
+	unsigned char pad[72];
+	size_t pad_len = (_used < 56) ? (56 - _used) : (120 - _used);
+	std::memset(pad, 0, sizeof(pad));
+	pad[0] = 0x80;
+	for (int i = 0; i < 8; i++)
+	{
+		pad[pad_len + i] = (unsigned char)(bits >> (i * 8));
+	}
+	update(pad, pad_len + 8);
+
+	static const char *hex = "0123456789abcdef";
+	std::string digest;
+	digest.reserve(32);
+	for (int i = 0; i < 4; i++)
+	{
+		for (int byte = 0; byte < 4; byte++)
+		{
+			unsigned int b = (_state[i] >> (byte * 8)) & 0xFF;
+			digest += hex[b >> 4];
+			digest += hex[b & 0xF];
+		}
+	}
+	return digest;
+}
+
+/**
+ * Process one 64 byte block
+ */
+void Md5::transform(const unsigned char *block)
+{
+	unsigned int m[16];
+	for (int i = 0; i < 16; i++)
+	{
+		m[i] = block[i*4]
+			| ((unsigned int)block[i*4+1] << 8)
+			| ((unsigned int)block[i*4+2] << 16)
+			| ((unsigned int)block[i*4+3] << 24);
+	}
+
+	unsigned int a = _state[0], b = _state[1], c = _state[2], d = _state[3];
+
+	for (int i = 0; i < 64; i++)
+	{
+		unsigned int f;
+		int g;
+		if (i < 16)
+		{
+			f = (b & c) | (~b & d);
+			g = i;
+		} else if (i < 32)
+		{
+			f = (d & b) | (~d & c);
+			g = (5 * i + 1) & 15;
+		} else if (i < 48)
+		{
+			f = b ^ c ^ d;
+			g = (3 * i + 5) & 15;
+		} else
+		{
+			f = c ^ (b | ~d);
+			g = (7 * i) & 15;
+		}
+		f += a + k[i] + m[g];
+		a = d;
+		d = c;
+		c = b;
+		b += rotl(f, s[i]);
+	}
+
+	_state[0] += a; _state[1] += b; _state[2] += c; _state[3] += d;
+}
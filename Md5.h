@@ -0,0 +1,54 @@
+/*
+ * Md5.h
+ *
+ */
+/*********************************************************************
+* Copyright 2018 Alan Buckley
+*
+* This file is part of japkg.
+*
+* japkg is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* japkg is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with PackIt. If not, see <http://www.gnu.org/licenses/>.
+*
+*****************************************************************************/
+
+#ifndef MD5_H_
+#define MD5_H_
+
+#include <cstddef>
+#include <string>
+
+/**
+ * Calculate the MD5 digest of a stream of data
+ */
+class Md5
+{
+public:
+	Md5();
+
+	void update(const void *data, size_t size);
+	void update(const std::string &text) {update(text.data(), text.size());}
+
+	std::string hex_digest();
+
+private:
+	void transform(const unsigned char *block);
+
+private:
+	unsigned int _state[4];
+	unsigned long long _length;
+	unsigned char _block[64];
+	size_t _used;
+};
+
+#endif /* MD5_H_ */
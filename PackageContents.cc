@@ -0,0 +1,228 @@
+/*
+ * PackageContents.cc
+ *
+ */
+/*********************************************************************
+* Copyright 2018 Alan Buckley
+*
+* This file is part of japkg.
+*
+* japkg is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* japkg is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with PackIt. If not, see <http://www.gnu.org/licenses/>.
+*
+*****************************************************************************/
+
+#include "PackageContents.h"
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdlib>
+
+/**
+ * Read the contents from the central directory of a package
+ *
+ * @param filename name of the package file
+ * @returns true if the package could be read
+ */
+bool PackageFileContents::read(const std::string &filename)
+{
+	ZipReader zip_reader;
+	if (!zip_reader.open(filename)) return false;
+
+	files.clear();
+	files.reserve(zip_reader.size());
+	for (const ZipEntry &entry : zip_reader)
+	{
+		if (!entry.directory()) files.push_back(entry);
+	}
+	std::sort(files.begin(), files.end());
+
+	return true;
+}
+
+PackageContents::PackageContents() :
+	_modified(false)
+{
+}
+
+/**
+ * Load the contents index
+ *
+ * Each package starts with a "Package:" line with its name, length,
+ * load and exec address. This is followed by one line per file with
+ * the CRC, size, compressed size, compression method, local header offset,
+ * date and extra data in hexadecimal and then the name.
+ * A blank line ends the package.
+ *
+ * @param filename name of the index file
+ * @returns true if the index was read
+ */
+bool PackageContents::load(const std::string &filename)
+{
+	std::ifstream in(filename.c_str());
+	if (!in) return false;
+
+	_packages.clear();
+	std::string line;
+	PackageFileContents *contents = nullptr;
+	while (std::getline(in, line))
+	{
+		if (line.empty())
+		{
+			contents = nullptr;
+		} else if (line.compare(0, 9, "Package: ") == 0)
+		{
+			std::istringstream fields(line.substr(9));
+			std::string name;
+			PackageFileContents read_contents;
+			if (fields >> name >> read_contents.length >> std::hex
+					>> read_contents.load_address >> read_contents.exec_address)
+			{
+				contents = &_packages[name];
+				*contents = read_contents;
+			}
+		} else if (contents)
+		{
+			std::istringstream fields(line);
+			ZipEntry entry;
+			std::string extra_hex;
+			fields >> std::hex >> entry.crc >> std::dec >> entry.size >> entry.compressed_size
+				>> entry.method >> entry.local_offset >> std::hex >> entry.dos_time >> extra_hex;
+			if (!fields || fields.get() != ' ') continue;
+			std::getline(fields, entry.name);
+
+			if (extra_hex != "-")
+			{
+				for (std::string::size_type pos = 0; pos + 1 < extra_hex.size(); pos += 2)
+				{
+					entry.extra += (char)std::strtol(extra_hex.substr(pos, 2).c_str(), nullptr, 16);
+				}
+			}
+			// Central directory position isn't saved so must not be used
+			entry.index = -1;
+			contents->files.push_back(entry);
+		}
+	}
+	_modified = false;
+
+	return true;
+}
+
+/**
+ * Save the contents index
+ *
+ * @param filename name of the index file
+ * @returns true if the index was saved
+ */
+bool PackageContents::save(const std::string &filename)
+{
+	std::ofstream out(filename.c_str());
+	if (!out) return false;
+
+	static const char *hex = "0123456789abcdef";
+	std::string extra_hex;
+	for (auto &package : _packages)
+	{
+		const PackageFileContents &contents = package.second;
+		out << "Package: " << package.first << " " << std::dec << contents.length
+			<< " " << std::hex << contents.load_address
+			<< " " << contents.exec_address << std::endl;
+		for (const ZipEntry &entry : contents.files)
+		{
+			extra_hex.clear();
+			for (unsigned char c : entry.extra)
+			{
+				extra_hex += hex[c >> 4];
+				extra_hex += hex[c & 0xF];
+			}
+			if (extra_hex.empty()) extra_hex = "-";
+
+			out << std::hex << entry.crc << std::dec
+				<< " " << entry.size
+				<< " " << entry.compressed_size
+				<< " " << entry.method
+				<< " " << entry.local_offset
+				<< " " << std::hex << entry.dos_time
+				<< " " << extra_hex
+				<< " " << entry.name << std::endl;
+		}
+		out << std::endl;
+	}
+	out.close();
+	if (!out) return false;
+
+	_modified = false;
+	return true;
+}
+
+/**
+ * Find the contents of a package
+ *
+ * @param name name of package file relative to the packages directory
+ * @returns pointer to the contents or nullptr if it isn't in the index
+ */
+const PackageFileContents *PackageContents::find(const std::string &name) const
+{
+	auto found = _packages.find(name);
+	return (found == _packages.end()) ? nullptr : &found->second;
+}
+
+/**
+ * Update the contents of a package if it is not in the index or it
+ * has changed since it was last read.
+ *
+ * @param name name of package file relative to the packages directory
+ * @param filename full name of the package file
+ * @param length size of the package file
+ * @param load_address load address of the package file
+ * @param exec_address exec address of the package file
+ * @returns true if the package is in the index
+ */
+bool PackageContents::update(const std::string &name, const std::string &filename,
+		unsigned int length, unsigned int load_address, unsigned int exec_address)
+{
+	auto found = _packages.find(name);
+	if (found != _packages.end()
+		&& found->second.length == length
+		&& found->second.load_address == load_address
+		&& found->second.exec_address == exec_address)
+	{
+		return true;
+	}
+
+	PackageFileContents contents;
+	contents.length = length;
+	contents.load_address = load_address;
+	contents.exec_address = exec_address;
+	if (!contents.read(filename))
+	{
+		if (found != _packages.end()) remove(name);
+		return false;
+	}
+
+	_packages[name] = contents;
+	_modified = true;
+
+	return true;
+}
+
+/**
+ * Remove a package from the index
+ *
+ * @param name name of package file relative to the packages directory
+ */
+void PackageContents::remove(const std::string &name)
+{
+	if (_packages.erase(name)) _modified = true;
+}
@@ -0,0 +1,91 @@
+/*
+ * PackageContents.h
+ *
+ */
+/*********************************************************************
+* Copyright 2018 Alan Buckley
+*
+* This file is part of japkg.
+*
+* japkg is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* japkg is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with PackIt. If not, see <http://www.gnu.org/licenses/>.
+*
+*****************************************************************************/
+
+#ifndef PACKAGECONTENTS_H_
+#define PACKAGECONTENTS_H_
+
+#include <string>
+#include <vector>
+#include <map>
+#include "ZipReader.h"
+
+/**
+ * Contents of one package file taken from its central directory
+ */
+struct PackageFileContents
+{
+	PackageFileContents() : length(0), load_address(0), exec_address(0) {}
+
+	/** Size of the package file when it was read */
+	unsigned int length;
+	/** Load address (with the date stamp) of the package file when it was read */
+	unsigned int load_address;
+	/** Exec address (with the date stamp) of the package file when it was read */
+	unsigned int exec_address;
+	/** Files in the package sorted by name, excluding directories.
+	 * This includes RiscPkg/Control so its CRC identifies the control record.
+	 * The index of entries loaded from the contents file is -1 as their
+	 * position in the central directory is not saved.
+	 */
+	std::vector<ZipEntry> files;
+
+	bool read(const std::string &filename);
+};
+
+/**
+ * Index of the contents of the existing packages.
+ *
+ * Only the central directory of a package is read to create its entry,
+ * and entries are kept between runs so a package only has to be read
+ * again if its size or date stamp change.
+ *
+ * Packages are keyed by the name of the file relative to the packages
+ * directory (e.g. "release.Elite_1/0-1") as used in the PackageManifest.
+ */
+class PackageContents
+{
+public:
+	PackageContents();
+
+	bool load(const std::string &filename);
+	bool save(const std::string &filename);
+	bool modified() const {return _modified;}
+
+	const PackageFileContents *find(const std::string &name) const;
+	bool update(const std::string &name, const std::string &filename,
+			unsigned int length, unsigned int load_address, unsigned int exec_address);
+	void remove(const std::string &name);
+
+	typedef std::map<std::string, PackageFileContents>::const_iterator const_iterator;
+	const_iterator begin() const {return _packages.cbegin();}
+	const_iterator end() const {return _packages.cend();}
+	const_iterator lower_bound(const std::string &name) const {return _packages.lower_bound(name);}
+	size_t size() const {return _packages.size();}
+
+private:
+	std::map<std::string, PackageFileContents> _packages;
+	bool _modified;
+};
+
+#endif /* PACKAGECONTENTS_H_ */
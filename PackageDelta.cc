@@ -0,0 +1,231 @@
+/*
+ * PackageDelta.cc
+ *
+ */
+/*********************************************************************
+* Copyright 2018 Alan Buckley
+*
+* This file is part of japkg.
+*
+* japkg is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* japkg is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with PackIt. If not, see <http://www.gnu.org/licenses/>.
+*
+*****************************************************************************/
+
+#include "PackageDelta.h"
+#include "ZipReader.h"
+#include "Sha256.h"
+#include "tbx/path.h"
+
+#include <map>
+#include <vector>
+#include <sstream>
+#include <iomanip>
+#include <cstdio>
+#include <cstdlib>
+
+#define _ZIP_SYSTEM_LINUX
+#include "ziparchive/ZipArchive.h"
+#include "ziparchive/ZipException.h"
+
+/**
+ * Create a delta from one version of a package to the next
+ *
+ * @param old_pkgfile full path of the previous version of the package
+ * @param new_pkgfile full path of the new version of the package
+ * @param delta_file full path of delta file to create
+ * @param error optional string updated with the reason for a failure
+ * @returns true if the delta was created
+ */
+bool PackageDelta::create(const std::string &old_pkgfile, const std::string &new_pkgfile,
+		const std::string &delta_file, std::string *error /*= nullptr*/)
+{
+	ZipReader old_reader, new_reader;
+	if (!old_reader.open(old_pkgfile))
+	{
+		if (error) *error = "Unable to read " + old_pkgfile;
+		return false;
+	}
+	if (!new_reader.open(new_pkgfile))
+	{
+		if (error) *error = "Unable to read " + new_pkgfile;
+		return false;
+	}
+
+	std::map<std::string, const ZipEntry *> old_entries;
+	for (const ZipEntry &entry : old_reader) old_entries[entry.name] = &entry;
+
+	std::ostringstream list;
+	list << "Base: " << tbx::Path(old_pkgfile).leaf_name() << std::endl;
+	std::vector<int> new_indices;
+	// Entries are only copied from the old package if everything stored
+	// for them is the same, including the date stamp and the extra data
+	// holding the RISC OS file type, or the rebuilt package would differ
+	for (const ZipEntry &entry : new_reader)
+	{
+		auto found = old_entries.find(entry.name);
+		bool unchanged = (found != old_entries.end()
+				&& found->second->crc == entry.crc
+				&& found->second->size == entry.size
+				&& found->second->compressed_size == entry.compressed_size
+				&& found->second->method == entry.method
+				&& found->second->dos_time == entry.dos_time
+				&& found->second->extra == entry.extra);
+		list << (unchanged ? "Old " : "New ")
+			<< std::hex << std::setw(8) << std::setfill('0') << entry.crc << std::dec
+			<< " " << entry.name << std::endl;
+		if (!unchanged) new_indices.push_back(entry.index);
+	}
+	old_reader.close();
+	new_reader.close();
+
+	CZipArchive delta;
+	bool ok = false;
+	try
+	{
+		CZipArchive new_zip;
+		new_zip.Open(new_pkgfile.c_str(), CZipArchive::zipOpenReadOnly);
+		delta.Open(delta_file.c_str(), CZipArchive::zipCreate);
+
+		// Date of the list is taken from the new package so deltas are reproducible
+		CZipFileHeader fhead;
+		fhead.SetFileName(list_name());
+		CZipFileHeader *first = (new_zip.GetCount() > 0) ? new_zip.GetFileInfo(0) : nullptr;
+		if (first) fhead.SetModificationTime(first->GetTime());
+
+		std::string text(list.str());
+		delta.OpenNewFile(fhead);
+		delta.WriteNewFile(text.c_str(), text.size());
+		delta.CloseNewFile();
+
+		for (int index : new_indices)
+		{
+			delta.GetFromArchive(new_zip, (ZIP_INDEX_TYPE)index);
+		}
+
+		delta.Close();
+		new_zip.Close();
+		ok = true;
+	} catch(CZipException &e)
+	{
+		std::string desc = e.GetErrorDescription();
+		if (error) *error = "Failed to create delta: " + desc;
+	} catch(...)
+	{
+		if (error) *error = "Unexpected exception thrown during delta creation";
+	}
+
+	if (!ok) std::remove(delta_file.c_str());
+
+	return ok;
+}
+
+/**
+ * Rebuild a package from the previous version and a delta
+ *
+ * @param old_pkgfile full path of the previous version of the package
+ * @param delta_file full path of the delta file
+ * @param rebuilt_pkgfile full path of the package to create
+ * @param error optional string updated with the reason for a failure
+ * @returns true if the package was rebuilt
+ */
+bool PackageDelta::rebuild(const std::string &old_pkgfile, const std::string &delta_file,
+		const std::string &rebuilt_pkgfile, std::string *error /*= nullptr*/)
+{
+	bool ok = false;
+	try
+	{
+		CZipArchive old_zip, delta, rebuilt;
+		old_zip.Open(old_pkgfile.c_str(), CZipArchive::zipOpenReadOnly);
+		delta.Open(delta_file.c_str(), CZipArchive::zipOpenReadOnly);
+		old_zip.EnableFindFast(true);
+		delta.EnableFindFast(true);
+
+		ZIP_INDEX_TYPE list_index = delta.FindFile(list_name(), CZipArchive::ffCaseSens);
+		CZipMemFile list_file;
+		if (list_index == ZIP_FILE_INDEX_NOT_FOUND || !delta.ExtractFile(list_index, list_file))
+		{
+			if (error) *error = delta_file + " is not a package delta";
+			return false;
+		}
+		int len = list_file.GetLength();
+		char *data = (char *)list_file.Detach();
+		std::istringstream list(std::string(data, len));
+		free(data);
+
+		rebuilt.Open(rebuilt_pkgfile.c_str(), CZipArchive::zipCreate);
+
+		std::string line;
+		ok = true;
+		while (ok && std::getline(list, line))
+		{
+			// Lines are "Old"/"New", 8 digit CRC then the name
+			if (line.size() < 14 || line.compare(0, 6, "Base: ") == 0) continue;
+			bool from_old = (line.compare(0, 4, "Old ") == 0);
+			std::string name(line, 13);
+			CZipArchive &from = from_old ? old_zip : delta;
+			ZIP_INDEX_TYPE index = from.FindFile(name.c_str(), CZipArchive::ffCaseSens);
+			if (index == ZIP_FILE_INDEX_NOT_FOUND)
+			{
+				if (error) *error = name + " missing from " + (from_old ? old_pkgfile : delta_file);
+				ok = false;
+			} else
+			{
+				rebuilt.GetFromArchive(from, index);
+			}
+		}
+
+		rebuilt.Close();
+		delta.Close();
+		old_zip.Close();
+	} catch(CZipException &e)
+	{
+		std::string desc = e.GetErrorDescription();
+		if (error) *error = "Failed to rebuild package from delta: " + desc;
+		ok = false;
+	} catch(...)
+	{
+		if (error) *error = "Unexpected exception thrown rebuilding package from delta";
+		ok = false;
+	}
+
+	if (!ok) std::remove(rebuilt_pkgfile.c_str());
+
+	return ok;
+}
+
+/**
+ * Check a package rebuilt from a delta is identical to the new package
+ *
+ * @param old_pkgfile full path of the previous version of the package
+ * @param new_pkgfile full path of the new version of the package
+ * @param delta_file full path of the delta file
+ * @param error optional string updated with the reason for a failure
+ * @returns true if the rebuilt package is identical to the new package
+ */
+bool PackageDelta::verify(const std::string &old_pkgfile, const std::string &new_pkgfile,
+		const std::string &delta_file, std::string *error /*= nullptr*/)
+{
+	std::string rebuilt_pkgfile(delta_file + "/chk");
+	if (!rebuild(old_pkgfile, delta_file, rebuilt_pkgfile, error)) return false;
+
+	std::string new_digest, rebuilt_digest;
+	bool same = Sha256::of_file(new_pkgfile, new_digest)
+			&& Sha256::of_file(rebuilt_pkgfile, rebuilt_digest)
+			&& new_digest == rebuilt_digest;
+	std::remove(rebuilt_pkgfile.c_str());
+
+	if (!same && error) *error = "Package rebuilt from delta is not identical to " + new_pkgfile;
+
+	return same;
+}
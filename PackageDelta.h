@@ -0,0 +1,58 @@
+/*
+ * PackageDelta.h
+ *
+ */
+/*********************************************************************
+* Copyright 2018 Alan Buckley
+*
+* This file is part of japkg.
+*
+* japkg is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* japkg is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with PackIt. If not, see <http://www.gnu.org/licenses/>.
+*
+*****************************************************************************/
+
+#ifndef PACKAGEDELTA_H_
+#define PACKAGEDELTA_H_
+
+#include <string>
+
+/**
+ * Create and apply delta files that hold the differences between two
+ * versions of a package.
+ *
+ * A delta is a zip file containing a "Delta" text file followed by the
+ * entries of the new package that are not in the old package with the
+ * same name, sizes, CRC, compression method, date stamp and extra data. The text file gives the leaf name of the old
+ * package and then one line for each entry of the new package in order.
+ * Each line is "Old" or "New" to say where the entry is copied from,
+ * its CRC in hexadecimal and its name.
+ *
+ * Entries are copied in their compressed form, so the new package can
+ * be rebuilt from the old package and the delta without recompressing.
+ */
+class PackageDelta
+{
+public:
+	static bool create(const std::string &old_pkgfile, const std::string &new_pkgfile,
+			const std::string &delta_file, std::string *error = nullptr);
+	static bool rebuild(const std::string &old_pkgfile, const std::string &delta_file,
+			const std::string &rebuilt_pkgfile, std::string *error = nullptr);
+	static bool verify(const std::string &old_pkgfile, const std::string &new_pkgfile,
+			const std::string &delta_file, std::string *error = nullptr);
+
+	/** Name of the file in the delta listing the entries */
+	static const char *list_name() {return "Delta";}
+};
+
+#endif /* PACKAGEDELTA_H_ */
@@ -0,0 +1,196 @@
+/*
+ * PackageIndex.cc
+ *
+ */
+/*********************************************************************
+* Copyright 2018 Alan Buckley
+*
+* This file is part of japkg.
+*
+* japkg is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* japkg is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with PackIt. If not, see <http://www.gnu.org/licenses/>.
+*
+*****************************************************************************/
+
+#include "PackageIndex.h"
+#include "PackageManifest.h"
+#include <fstream>
+
+/**
+ * Load the control records from an index written previously
+ *
+ * The Size, MD5Sum and URL fields added for the index are removed
+ * so the record is the same as the control file in the package.
+ *
+ * @param filename name of index file
+ * @param prefix package directory name and "." added to the front of the key
+ * @returns true if the index was read
+ */
+bool PackageIndex::load(const std::string &filename, const std::string &prefix)
+{
+	std::ifstream in(filename.c_str());
+	if (!in) return false;
+
+	std::string line, control, package, version;
+	bool more = true;
+	while (more)
+	{
+		more = std::getline(in, line) ? true : false;
+		if (!more || line.empty())
+		{
+			if (!control.empty() && !package.empty() && !version.empty())
+			{
+				// Key is the standard leaf name of the package
+				std::string leafname(package + "_" + version);
+				std::string::size_type dot_pos;
+				while ((dot_pos = leafname.find('.'))!= std::string::npos) leafname[dot_pos] = '/';
+				_controls[prefix + leafname] = control;
+				_modified = true;
+			}
+			control.clear();
+			package.clear();
+			version.clear();
+		} else if (line.compare(0, 5, "Size:") != 0
+				&& line.compare(0, 7, "MD5Sum:") != 0
+				&& line.compare(0, 4, "URL:") != 0)
+		{
+			if (line.compare(0, 9, "Package: ") == 0) package = line.substr(9);
+			else if (line.compare(0, 9, "Version: ") == 0) version = line.substr(9);
+			control += line;
+			control += '\n';
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Load the store written by save_store
+ *
+ * Each record starts with a "File:" line giving its key followed
+ * by the control record and a blank line.
+ *
+ * @param filename name of the store file
+ * @returns true if the store was read
+ */
+bool PackageIndex::load_store(const std::string &filename)
+{
+	std::ifstream in(filename.c_str());
+	if (!in) return false;
+
+	_controls.clear();
+	std::string line, name, control;
+	bool more = true;
+	while (more)
+	{
+		more = std::getline(in, line) ? true : false;
+		if (!more || line.empty())
+		{
+			if (!name.empty()) _controls[name] = control;
+			name.clear();
+			control.clear();
+		} else if (name.empty())
+		{
+			if (line.compare(0, 6, "File: ") == 0) name = line.substr(6);
+		} else
+		{
+			control += line;
+			control += '\n';
+		}
+	}
+	_modified = false;
+
+	return true;
+}
+
+/**
+ * Save the control records so they can be reloaded with load_store
+ *
+ * @param filename name of the store file
+ * @returns true if the store was written
+ */
+bool PackageIndex::save_store(const std::string &filename)
+{
+	std::ofstream out(filename.c_str());
+	if (!out) return false;
+
+	for (auto &entry : _controls)
+	{
+		out << "File: " << entry.first << std::endl;
+		out << entry.second;
+		if (!entry.second.empty() && entry.second[entry.second.size()-1] != '\n') out << std::endl;
+		out << std::endl;
+	}
+	out.close();
+	if (!out) return false;
+
+	_modified = false;
+	return true;
+}
+
+/**
+ * Find the control record for a package file
+ *
+ * @param name name of file relative to packages directory
+ * @returns pointer to control record or nullptr if not found
+ */
+const std::string *PackageIndex::find(const std::string &name) const
+{
+	auto found = _controls.find(name);
+	return (found == _controls.end()) ? nullptr : &found->second;
+}
+
+/**
+ * Set the control record for a package file
+ *
+ * @param name name of file relative to packages directory
+ * @param control text of control record
+ */
+void PackageIndex::set(const std::string &name, const std::string &control)
+{
+	std::string &current = _controls[name];
+	if (current != control)
+	{
+		current = control;
+		_modified = true;
+	}
+}
+
+/**
+ * Remove the control record for a package file
+ *
+ * @param name name of file relative to packages directory
+ */
+void PackageIndex::remove(const std::string &name)
+{
+	if (_controls.erase(name)) _modified = true;
+}
+
+/**
+ * Write one record to the index
+ *
+ * @param os stream to write to
+ * @param control control record of the package
+ * @param digests size and digest of the package file
+ * @param url URL the package can be downloaded from
+ */
+void PackageIndex::write_record(std::ostream &os, const std::string &control,
+		const PackageDigests &digests, const std::string &url)
+{
+	os << control;
+	if (!control.empty() && control[control.size()-1] != '\n') os << std::endl;
+	os << "Size: " << digests.size << std::endl;
+	os << "MD5Sum: " << digests.md5 << std::endl;
+	os << "URL: " << url << std::endl;
+	os << std::endl;
+}
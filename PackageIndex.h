@@ -0,0 +1,74 @@
+/*
+ * PackageIndex.h
+ *
+ */
+/*********************************************************************
+* Copyright 2018 Alan Buckley
+*
+* This file is part of japkg.
+*
+* japkg is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* japkg is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with PackIt. If not, see <http://www.gnu.org/licenses/>.
+*
+*****************************************************************************/
+
+#ifndef PACKAGEINDEX_H_
+#define PACKAGEINDEX_H_
+
+#include <string>
+#include <map>
+#include <ostream>
+
+struct PackageDigests;
+
+/**
+ * Control records of the packages in the repository used to write
+ * the RiscPkg index for each package directory.
+ *
+ * Records are keyed by the name of the package file relative to
+ * the packages directory (e.g. "release.Elite_1/0-1") as used
+ * in the PackageManifest. As the file name is made from the package
+ * name and version this keeps the records for each package together
+ * in version order.
+ *
+ * The records are kept between runs in a store file so only the
+ * packages that have been added or removed need to be updated.
+ */
+class PackageIndex
+{
+public:
+	PackageIndex() : _modified(false) {}
+
+	bool load(const std::string &filename, const std::string &prefix);
+	bool load_store(const std::string &filename);
+	bool save_store(const std::string &filename);
+	bool modified() const {return _modified;}
+
+	const std::string *find(const std::string &name) const;
+	void set(const std::string &name, const std::string &control);
+	void remove(const std::string &name);
+
+	typedef std::map<std::string, std::string>::const_iterator const_iterator;
+	const_iterator begin() const {return _controls.cbegin();}
+	const_iterator end() const {return _controls.cend();}
+	const_iterator lower_bound(const std::string &name) const {return _controls.lower_bound(name);}
+
+	static void write_record(std::ostream &os, const std::string &control,
+			const PackageDigests &digests, const std::string &url);
+
+private:
+	std::map<std::string, std::string> _controls;
+	bool _modified;
+};
+
+#endif /* PACKAGEINDEX_H_ */
@@ -0,0 +1,215 @@
+/*
+ * PackageManifest.cc
+ *
+ */
+/*********************************************************************
+* Copyright 2018 Alan Buckley
+*
+* This file is part of japkg.
+*
+* japkg is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* japkg is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with PackIt. If not, see <http://www.gnu.org/licenses/>.
+*
+*****************************************************************************/
+
+#include "PackageManifest.h"
+#include "Md5.h"
+#include "Sha256.h"
+#include "tbx/path.h"
+#include <fstream>
+#include <sstream>
+
+/**
+ * Calculate the size and digests of an existing file
+ *
+ * @param filename name of file
+ * @returns true if the file could be read
+ */
+bool PackageDigests::calculate(const std::string &filename)
+{
+	std::ifstream in(filename.c_str(), std::ios::binary);
+	if (!in) return false;
+
+	Md5 md5_calc;
+	Sha256 sha256_calc;
+	char buffer[16384];
+	size = 0;
+	while (in)
+	{
+		in.read(buffer, sizeof(buffer));
+		std::streamsize got = in.gcount();
+		if (got)
+		{
+			md5_calc.update(buffer, got);
+			sha256_calc.update(buffer, got);
+			size += got;
+		}
+	}
+	if (in.bad()) return false;
+
+	md5 = md5_calc.hex_digest();
+	sha256 = sha256_calc.hex_digest();
+	control_fingerprint = copyright_fingerprint = 0;
+	fingerprints_known = false;
+	read_stamp(filename);
+	return true;
+}
+
+/**
+ * Record the load and execute addresses of the file the digests are for
+ *
+ * @param filename name of file
+ */
+void PackageDigests::read_stamp(const std::string &filename)
+{
+	tbx::PathInfo info;
+	if (tbx::Path(filename).path_info(info))
+	{
+		load_address = info.load_address();
+		exec_address = info.exec_address();
+	} else
+	{
+		load_address = exec_address = 0;
+	}
+}
+
+PackageManifest::PackageManifest() :
+	_modified(false)
+{
+}
+
+/**
+ * Load the manifest
+ *
+ * @param filename name of manifest file
+ * @returns true if loaded, false if it does not exist or could not be read
+ */
+bool PackageManifest::load(const std::string &filename)
+{
+	std::ifstream in(filename.c_str());
+	if (!in) return false;
+
+	_entries.clear();
+	std::string line;
+	while (std::getline(in, line))
+	{
+		std::istringstream fields(line);
+		std::string name;
+		PackageDigests digests;
+		if (fields >> name >> digests.size >> digests.md5 >> digests.sha256)
+		{
+			// Fingerprints and addresses are missing from older manifests
+			// and fingerprints that are not known are written as "-"
+			std::string control_text, copyright_text;
+			if (fields >> control_text >> copyright_text)
+			{
+				if (control_text != "-")
+				{
+					std::istringstream fingerprints(control_text + " " + copyright_text);
+					if (fingerprints >> std::hex >> digests.control_fingerprint >> digests.copyright_fingerprint)
+					{
+						digests.fingerprints_known = true;
+					} else
+					{
+						digests.control_fingerprint = digests.copyright_fingerprint = 0;
+					}
+				}
+				if (!(fields >> std::hex >> digests.load_address >> digests.exec_address))
+				{
+					digests.load_address = digests.exec_address = 0;
+				}
+			}
+			_entries[name] = digests;
+		}
+	}
+	_modified = false;
+
+	return true;
+}
+
+/**
+ * Save the manifest
+ *
+ * @param filename name of manifest file
+ * @returns true if saved
+ */
+bool PackageManifest::save(const std::string &filename)
+{
+	std::ofstream out(filename.c_str());
+	if (!out) return false;
+
+	for (auto &entry : _entries)
+	{
+		out << entry.first << " " << entry.second.size
+			<< " " << entry.second.md5
+			<< " " << entry.second.sha256;
+		if (entry.second.has_fingerprints() || entry.second.has_stamp())
+		{
+			out << std::hex;
+			if (entry.second.has_fingerprints())
+			{
+				out << " " << entry.second.control_fingerprint
+					<< " " << entry.second.copyright_fingerprint;
+			} else
+			{
+				out << " - -";
+			}
+			if (entry.second.has_stamp())
+			{
+				out << " " << entry.second.load_address
+					<< " " << entry.second.exec_address;
+			}
+			out << std::dec;
+		}
+		out << std::endl;
+	}
+	out.close();
+	if (!out) return false;
+
+	_modified = false;
+	return true;
+}
+
+/**
+ * Find the digests for a package
+ *
+ * @param name name of package relative to the packages directory
+ * @returns pointer to digests or nullptr if the package is not in the manifest
+ */
+const PackageDigests *PackageManifest::find(const std::string &name) const
+{
+	auto found = _entries.find(name);
+	return (found == _entries.end()) ? nullptr : &found->second;
+}
+
+/**
+ * Set the digests for a package
+ *
+ * @param name name of package relative to the packages directory
+ * @param digests size and digests of the package
+ */
+void PackageManifest::set(const std::string &name, const PackageDigests &digests)
+{
+	_entries[name] = digests;
+	_modified = true;
+}
+
+/**
+ * Remove a package from the manifest
+ *
+ * @param name name of package relative to the packages directory
+ */
+void PackageManifest::remove(const std::string &name)
+{
+	if (_entries.erase(name)) _modified = true;
+}
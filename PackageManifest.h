@@ -0,0 +1,107 @@
+/*
+ * PackageManifest.h
+ *
+ */
+/*********************************************************************
+* Copyright 2018 Alan Buckley
+*
+* This file is part of japkg.
+*
+* japkg is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* japkg is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with PackIt. If not, see <http://www.gnu.org/licenses/>.
+*
+*****************************************************************************/
+
+#ifndef PACKAGEMANIFEST_H_
+#define PACKAGEMANIFEST_H_
+
+#include <string>
+#include <map>
+
+/**
+ * Size and digests of a package file
+ */
+struct PackageDigests
+{
+	PackageDigests() : size(0), load_address(0), exec_address(0),
+		control_fingerprint(0), copyright_fingerprint(0), fingerprints_known(false) {}
+
+	/** Size of the package file in bytes */
+	unsigned long long size;
+	/** Load address of the package file (file type and date stamp), 0 if not known */
+	unsigned int load_address;
+	/** Execute address of the package file (rest of the date stamp) */
+	unsigned int exec_address;
+	/** MD5 digest in hexadecimal */
+	std::string md5;
+	/** SHA-256 digest in hexadecimal */
+	std::string sha256;
+	/** Fingerprint of the control record */
+	unsigned long long control_fingerprint;
+	/** Fingerprint of the copyright */
+	unsigned long long copyright_fingerprint;
+	/** true if the fingerprints have been set, as 0 is a valid fingerprint */
+	bool fingerprints_known;
+
+	/** Check if the control record and copyright fingerprints are known */
+	bool has_fingerprints() const {return fingerprints_known;}
+	/** Check if the load and execute addresses of the package file are known */
+	bool has_stamp() const {return load_address != 0 || exec_address != 0;}
+	/** Check if the package file may have changed since the digests were calculated */
+	bool changed(unsigned long long new_size, unsigned int new_load_address, unsigned int new_exec_address) const
+	{
+		return size != new_size
+			|| (has_stamp() && (load_address != new_load_address || exec_address != new_exec_address));
+	}
+
+	bool calculate(const std::string &filename);
+	void read_stamp(const std::string &filename);
+};
+
+/**
+ * Sizes and digests of the packages that have been created.
+ *
+ * This is saved alongside the packages so an index of them can be
+ * produced without reading each package again.
+ *
+ * Each line of the file is the name of the package relative to the
+ * packages directory followed by its size, MD5 and SHA-256 separated
+ * by spaces. These may be followed by the fingerprints of the control
+ * record and copyright and then the load and execute addresses of the
+ * package file, all in hexadecimal. Fingerprints that are not known
+ * are written as "-".
+ */
+class PackageManifest
+{
+public:
+	PackageManifest();
+
+	bool load(const std::string &filename);
+	bool save(const std::string &filename);
+	bool modified() const {return _modified;}
+
+	const PackageDigests *find(const std::string &name) const;
+	void set(const std::string &name, const PackageDigests &digests);
+	void remove(const std::string &name);
+
+	typedef std::map<std::string, PackageDigests>::const_iterator const_iterator;
+	const_iterator begin() const {return _entries.cbegin();}
+	const_iterator end() const {return _entries.cend();}
+	size_t size() const {return _entries.size();}
+
+private:
+	std::map<std::string, PackageDigests> _entries;
+	bool _modified;
+};
+
+#endif /* PACKAGEMANIFEST_H_ */
@@ -0,0 +1,313 @@
+/*
+ * PackageTree.cc
+ *
+ */
+/*********************************************************************
+* Copyright 2018 Alan Buckley
+*
+* This file is part of japkg.
+*
+* japkg is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* japkg is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with PackIt. If not, see <http://www.gnu.org/licenses/>.
+*
+*****************************************************************************/
+
+#include "PackageTree.h"
+#include "Packager.h"
+#include "DirScan.h"
+#include "tbx/path.h"
+
+#include <algorithm>
+#include <utility>
+
+/**
+ * Construct file details from its catalogue information
+ *
+ * @param entry catalogue information for the file
+ */
+PackageFile::PackageFile(const tbx::PathInfo &entry) :
+	dir(0),
+	leaf_offset(0),
+	leaf_length(0),
+	length(entry.length()),
+	extra(entry),
+	dated(entry.has_file_type()),
+	modified(0)
+{
+	if (dated)
+	{
+		long long csecs_since_1900 = entry.modified_time().centiseconds();
+		long long secs_between = 25567; // days
+		secs_between *= 24 * 60 * 60; // seconds
+		modified = (std::time_t)(csecs_since_1900/100 - secs_between);
+	}
+}
+
+/**
+ * Construct file details from the entry currently being read from a directory
+ *
+ * @param entry directory scan positioned on the file
+ */
+PackageFile::PackageFile(const DirScan &entry) :
+	dir(0),
+	leaf_offset(0),
+	leaf_length(0),
+	length(entry.length()),
+	extra(entry.load_address(), entry.exec_address(), entry.attributes()),
+	dated((entry.load_address() & 0xFFF00000) == 0xFFF00000),
+	modified(0)
+{
+	if (dated)
+	{
+		long long csecs_since_1900 = entry.load_address() & 0xFF;
+		csecs_since_1900 = (csecs_since_1900 << 32) | entry.exec_address();
+		long long secs_between = 25567; // days
+		secs_between *= 24 * 60 * 60; // seconds
+		modified = (std::time_t)(csecs_since_1900/100 - secs_between);
+	}
+}
+
+PackageTree::PackageTree() :
+	_total_length(0),
+	_built(false)
+{
+}
+
+/**
+ * Build the snapshot of the files for the given items
+ *
+ * @param items items to package
+ * @param error optional string updated with the reason for a failure
+ * @returns true if the snapshot was built
+ */
+bool PackageTree::build(const std::vector<ItemToPackage> &items, std::string *error /*= nullptr*/)
+{
+	clear();
+	unsigned int last_dir_number = 0;
+	bool ok = scan(items, [this, &last_dir_number](const PackageFile &file, const PackageFileNames &names)
+	{
+		if (_dirs.empty() || names.dir_number != last_dir_number)
+		{
+			PackageDir dir;
+			dir.disc_offset = _names.size();
+			dir.disc_length = names.disc_leaf;
+			_names.append(names.disc_name, 0, names.disc_leaf);
+			dir.zip_offset = _names.size();
+			dir.zip_length = names.zip_leaf;
+			_names.append(names.zip_name, 0, names.zip_leaf);
+			_dirs.push_back(dir);
+			last_dir_number = names.dir_number;
+		}
+		_files.push_back(file);
+		PackageFile &added = _files.back();
+		added.dir = _dirs.size() - 1;
+		added.leaf_offset = _names.size();
+		added.leaf_length = names.disc_name.size() - names.disc_leaf;
+		_names.append(names.disc_name, names.disc_leaf, std::string::npos);
+		_total_length += file.length;
+	}, error);
+
+	if (ok) _built = true;
+	else clear();
+
+	return ok;
+}
+
+/**
+ * Remove the snapshot so it will be rebuilt when next used
+ */
+void PackageTree::clear()
+{
+	_names.clear();
+	_dirs.clear();
+	_files.clear();
+	_total_length = 0;
+	_built = false;
+}
+
+/**
+ * Get the full RISC OS name of a file on disc
+ *
+ * @param file file from this tree
+ * @param name string to update with the name
+ */
+void PackageTree::disc_name(const PackageFile &file, std::string &name) const
+{
+	const PackageDir &dir = _dirs[file.dir];
+	name.assign(_names, dir.disc_offset, dir.disc_length);
+	name.append(_names, file.leaf_offset, file.leaf_length);
+}
+
+/**
+ * Get the name of a file in the zip archive
+ *
+ * @param file file from this tree
+ * @param name string to update with the name
+ */
+void PackageTree::zip_name(const PackageFile &file, std::string &name) const
+{
+	const PackageDir &dir = _dirs[file.dir];
+	name.assign(_names, dir.zip_offset, dir.zip_length);
+	append_zip_name(name, _names.data() + file.leaf_offset, file.leaf_length);
+}
+
+/**
+ * Append a RISC OS leaf or path to a zip name swapping "." and "/"
+ *
+ * @param zip_name zip name to append to
+ * @param riscos_name RISC OS name to append
+ * @param len length of name to append
+ */
+void PackageTree::append_zip_name(std::string &zip_name, const char *riscos_name, std::string::size_type len)
+{
+	const char *end = riscos_name + len;
+	while (riscos_name != end)
+	{
+		char c = *riscos_name++;
+		if (c == '.') c = '/';
+		else if (c == '/') c = '.';
+		zip_name += c;
+	}
+}
+
+/**
+ * Walk the files for the given items calling visit for each one
+ * as it is read from disc.
+ *
+ * @param items items to package
+ * @param visit function called for each file
+ * @param error optional string updated with the reason for a failure
+ * @returns true if all the items could be read
+ */
+bool PackageTree::scan(const std::vector<ItemToPackage> &items, Visitor visit, std::string *error /*= nullptr*/)
+{
+	std::string disc_name, zip_name;
+	unsigned int dir_number = 0;
+
+	for (const ItemToPackage &item : items)
+	{
+		tbx::Path files(item.source());
+		std::string leaf_name(files.leaf_name());
+
+		tbx::PathInfo root_info;
+		if (!files.path_info(root_info))
+		{
+			if (error) *error = "Unable to read file/directory " + item.source();
+			return false;
+		}
+
+		zip_name = Packager::riscos_to_zip_name(item.install_to() + "." + leaf_name);
+		disc_name = item.source();
+
+		if (root_info.directory())
+		{
+			if (!scan_dir(disc_name, zip_name, visit, dir_number, error)) return false;
+		} else
+		{
+		    if (root_info.image_file())
+		    {
+		       // Image file systems don't by default give a file type
+		       // so re-read it and calculate
+		       files.raw_path_info(root_info, true);
+		    }
+		    PackageFileNames names = {disc_name, zip_name,
+		    		disc_name.size() - leaf_name.size(),
+		    		zip_name.size() - leaf_name.size(),
+		    		++dir_number};
+			visit(PackageFile(root_info), names);
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Scan a directory
+ *
+ * The files in the directory are visited in name order before
+ * recursing into the sub directories, so the order does not depend
+ * on the order the filing system returns them in.
+ *
+ * @param disc_name name of the directory on disc, used to build
+ * the file names and restored before returning
+ * @param zip_name name of the directory in the zip archive, used to build
+ * the file names and restored before returning
+ * @param visit function to call for each file
+ * @param dir_number number incremented for each directory
+ * @param error optional string updated with the reason for a failure
+ * @returns true if the directory and all its sub directories could be read
+ */
+bool PackageTree::scan_dir(std::string &disc_name, std::string &zip_name, Visitor &visit, unsigned int &dir_number, std::string *error)
+{
+	std::vector<std::string> subdirs;
+	std::vector<std::pair<std::string, PackageFile> > files;
+	std::string::size_type disc_dir_len = disc_name.size();
+	std::string::size_type zip_dir_len = zip_name.size();
+
+	// Names are built on the end of the directory names
+	// which are kept for the whole directory
+	disc_name += '.';
+	zip_name += '/';
+	std::string::size_type disc_prefix_len = disc_name.size();
+	std::string::size_type zip_prefix_len = zip_name.size();
+	PackageFileNames names = {disc_name, zip_name, disc_prefix_len, zip_prefix_len, ++dir_number};
+
+	DirScan scan(disc_name.substr(0, disc_dir_len));
+	while (scan.next())
+	{
+		if (scan.directory())
+		{
+			// Go down directories after processing all files
+			subdirs.push_back(scan.name());
+		} else
+		{
+			files.push_back(std::make_pair(std::string(scan.name()), PackageFile(scan)));
+		}
+	}
+	if (scan.error())
+	{
+		// Don't package a directory that may only have been partly read
+		if (error) *error = "Unable to read directory " + disc_name.substr(0, disc_dir_len);
+		return false;
+	}
+
+	std::sort(files.begin(), files.end(),
+		[](const std::pair<std::string, PackageFile> &a, const std::pair<std::string, PackageFile> &b)
+		{
+			return a.first < b.first;
+		});
+	std::sort(subdirs.begin(), subdirs.end());
+
+	for (const std::pair<std::string, PackageFile> &file : files)
+	{
+		disc_name.resize(disc_prefix_len);
+		disc_name += file.first;
+		zip_name.resize(zip_prefix_len);
+		append_zip_name(zip_name, file.first.data(), file.first.size());
+		visit(file.second, names);
+	}
+
+	for (std::string &subdir : subdirs)
+	{
+		disc_name.resize(disc_prefix_len);
+		disc_name += subdir;
+		zip_name.resize(zip_prefix_len);
+		append_zip_name(zip_name, subdir.data(), subdir.size());
+		if (!scan_dir(disc_name, zip_name, visit, dir_number, error)) return false;
+	}
+
+	disc_name.resize(disc_dir_len);
+	zip_name.resize(zip_dir_len);
+
+	return true;
+}
@@ -0,0 +1,146 @@
+/*
+ * PackageTree.h
+ *
+ */
+/*********************************************************************
+* Copyright 2018 Alan Buckley
+*
+* This file is part of japkg.
+*
+* japkg is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* japkg is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with PackIt. If not, see <http://www.gnu.org/licenses/>.
+*
+*****************************************************************************/
+
+#ifndef PACKAGETREE_H_
+#define PACKAGETREE_H_
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <ctime>
+#include "RISCOSZipExtra.h"
+
+class ItemToPackage;
+class DirScan;
+
+namespace tbx
+{
+	class PathInfo;
+}
+
+/**
+ * Details of a single file on disc that will be put in a package
+ *
+ * The names of the file are held by the PackageTree it belongs to.
+ */
+struct PackageFile
+{
+	PackageFile(const tbx::PathInfo &entry);
+	PackageFile(const DirScan &entry);
+
+	/** Index of directory in the PackageTree */
+	unsigned int dir;
+	/** Offset of leaf name in PackageTree name store */
+	unsigned int leaf_offset;
+	/** Length of leaf name */
+	unsigned int leaf_length;
+	/** Size of the file in bytes */
+	unsigned int length;
+	/** RISC OS load/exec address and attributes */
+	RISCOSZipExtra extra;
+	/** true if the file has a date stamp */
+	bool dated;
+	/** Modification time (only valid if dated is true) */
+	std::time_t modified;
+};
+
+/**
+ * Names of a file as it is found by PackageTree::scan.
+ *
+ * The strings are reused for the next file so must be copied
+ * if they are needed later.
+ */
+struct PackageFileNames
+{
+	/** Full RISC OS name of the file on disc */
+	const std::string &disc_name;
+	/** Name of the file in the zip archive */
+	const std::string &zip_name;
+	/** Position of the leaf name in disc_name */
+	std::string::size_type disc_leaf;
+	/** Position of the leaf name in zip_name */
+	std::string::size_type zip_leaf;
+	/** Number that changes when a new directory is started */
+	unsigned int dir_number;
+};
+
+/**
+ * Snapshot of the files on disc for all the items in a package.
+ *
+ * The files are held in the order they are written to the zip file.
+ * i.e. the files in a directory followed by the contents of each
+ * of its sub directories.
+ *
+ * Names are kept in a single store with each directory name stored
+ * once in both RISC OS and zip form followed by the leaf names of the
+ * files it contains. Full names are put together when they are needed
+ * in a string supplied by the caller, so it can be reused for each file.
+ */
+class PackageTree
+{
+public:
+	PackageTree();
+
+	typedef std::function<void(const PackageFile &, const PackageFileNames &)> Visitor;
+
+	bool build(const std::vector<ItemToPackage> &items, std::string *error = nullptr);
+	void clear();
+	bool built() const {return _built;}
+
+	static bool scan(const std::vector<ItemToPackage> &items, Visitor visit, std::string *error = nullptr);
+
+	typedef std::vector<PackageFile>::const_iterator const_iterator;
+	const_iterator begin() const {return _files.cbegin();}
+	const_iterator end() const {return _files.cend();}
+
+	size_t size() const {return _files.size();}
+	unsigned long long total_length() const {return _total_length;}
+
+	void disc_name(const PackageFile &file, std::string &name) const;
+	void zip_name(const PackageFile &file, std::string &name) const;
+
+	static void append_zip_name(std::string &zip_name, const char *riscos_name, std::string::size_type len);
+
+private:
+	static bool scan_dir(std::string &disc_name, std::string &zip_name, Visitor &visit, unsigned int &dir_number, std::string *error);
+
+private:
+	/**
+	 * Location of a directories names in the name store
+	 */
+	struct PackageDir
+	{
+		unsigned int disc_offset;
+		unsigned int disc_length;
+		unsigned int zip_offset;
+		unsigned int zip_length;
+	};
+	std::string _names;
+	std::vector<PackageDir> _dirs;
+	std::vector<PackageFile> _files;
+	unsigned long long _total_length;
+	bool _built;
+};
+
+#endif /* PACKAGETREE_H_ */
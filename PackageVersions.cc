@@ -0,0 +1,166 @@
+/*
+ * PackageVersions.cc
+ *
+ */
+/*********************************************************************
+* Copyright 2018 Alan Buckley
+*
+* This file is part of japkg.
+*
+* japkg is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* japkg is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with PackIt. If not, see <http://www.gnu.org/licenses/>.
+*
+*****************************************************************************/
+
+#include "PackageVersions.h"
+#include "DirScan.h"
+#include "version.h"
+#include "tbx/path.h"
+
+/**
+ * Add all the packages in a directory
+ *
+ * Files whose version can not be parsed are skipped so one bad file
+ * doesn't stop the rest being read.
+ *
+ * @param dirname name of the directory
+ * @param type package type which is also the leaf name of the directory
+ * @param invalid optional list updated with the leaf names of the files skipped
+ * @returns false if the directory exists but could not be read
+ */
+bool PackageVersions::scan(const std::string &dirname, const std::string &type, std::vector<std::string> *invalid /*= nullptr*/)
+{
+	tbx::Path package_dir(dirname);
+	// Missing directory
+	if (!package_dir.directory()) return true;
+
+	DirScan scan(dirname);
+	while (scan.next())
+	{
+		try
+		{
+			add(type, scan.name());
+		} catch(pkg::version::parse_error &)
+		{
+			if (invalid) invalid->push_back(scan.name());
+		}
+	}
+
+	return !scan.error();
+}
+
+/**
+ * Add a package file
+ *
+ * @param type package type which is also the leaf name of the directory
+ * @param leafname leaf name of the package file which is made up of
+ * the package name and version separated by an underscore
+ * @returns true if the leaf name was a package name and version
+ * @throws pkg::version::parse_error if the version contains illegal characters
+ */
+bool PackageVersions::add(const std::string &type, const std::string &leafname)
+{
+	std::string::size_type us_pos = leafname.rfind('_');
+	if (us_pos == std::string::npos) return false;
+
+	std::string pkgname = leafname.substr(0,us_pos);
+	std::string ver = leafname.substr(us_pos+1);
+	// Convert slashes back to dots for version
+	std::string::size_type slash_pos;
+	while ((slash_pos = ver.find("/")) != std::string::npos) ver[slash_pos] = '.';
+
+	Entry entry;
+	entry.version = &VersionKey::intern(ver);
+	entry.type = type;
+	entry.leafname = leafname;
+
+	Entries &entries = _packages[pkgname];
+	Entries::iterator pos = entries.begin();
+	while (pos != entries.end() && *pos->version >= *entry.version) ++pos;
+	entries.insert(pos, entry);
+
+	return true;
+}
+
+/**
+ * Find all the versions of a package
+ *
+ * @param pkgname name of the package
+ * @returns versions newest first or nullptr if there are none
+ */
+const PackageVersions::Entries *PackageVersions::find(const std::string &pkgname) const
+{
+	auto found = _packages.find(pkgname);
+	return (found == _packages.end()) ? nullptr : &found->second;
+}
+
+/**
+ * Get the newest version of a package
+ *
+ * @param pkgname name of the package
+ * @returns newest version or nullptr if there are none
+ */
+const VersionKey *PackageVersions::newest(const std::string &pkgname) const
+{
+	const Entries *entries = find(pkgname);
+	return (entries && !entries->empty()) ? entries->front().version : nullptr;
+}
+
+/**
+ * Get the package files that are older than the newest versions
+ * kept of each package in each directory.
+ *
+ * The newest version of a package is always kept.
+ *
+ * @param keep number of versions of each package to keep in each directory
+ * @param old_entries vector updated with the package files that are not kept
+ */
+void PackageVersions::superseded(unsigned int keep, std::vector<Entry> &old_entries) const
+{
+	if (keep == 0) keep = 1;
+	std::map<std::string, unsigned int> kept;
+	for (auto &package : _packages)
+	{
+		const VersionKey *newest = package.second.front().version;
+		kept.clear();
+		for (const Entry &entry : package.second)
+		{
+			unsigned int &count = kept[entry.type];
+			if (count < keep || *entry.version == *newest) count++;
+			else old_entries.push_back(entry);
+		}
+	}
+}
+
+/**
+ * Remove a package file from the versions
+ *
+ * @param entry entry returned from find or superseded
+ */
+void PackageVersions::remove(const Entry &entry)
+{
+	std::string::size_type us_pos = entry.leafname.rfind('_');
+	auto found = _packages.find(entry.leafname.substr(0, us_pos));
+	if (found == _packages.end()) return;
+
+	Entries &entries = found->second;
+	for (Entries::iterator it = entries.begin(); it != entries.end(); ++it)
+	{
+		if (it->type == entry.type && it->leafname == entry.leafname)
+		{
+			entries.erase(it);
+			break;
+		}
+	}
+	if (entries.empty()) _packages.erase(found);
+}
@@ -0,0 +1,75 @@
+/*
+ * PackageVersions.h
+ *
+ */
+/*********************************************************************
+* Copyright 2018 Alan Buckley
+*
+* This file is part of japkg.
+*
+* japkg is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* japkg is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with PackIt. If not, see <http://www.gnu.org/licenses/>.
+*
+*****************************************************************************/
+
+#ifndef PACKAGEVERSIONS_H_
+#define PACKAGEVERSIONS_H_
+
+#include <string>
+#include <vector>
+#include <map>
+#include "VersionKey.h"
+
+/**
+ * Every version of each package in the package directories.
+ *
+ * The versions of a package are kept sorted newest first so the
+ * current version and the versions superseded by it are found
+ * without comparing versions again.
+ */
+class PackageVersions
+{
+public:
+	/**
+	 * A package file in one of the package directories
+	 */
+	struct Entry
+	{
+		/** Version of the package */
+		const VersionKey *version;
+		/** Package type which is the name of the directory */
+		std::string type;
+		/** Leaf name of the package file */
+		std::string leafname;
+	};
+	typedef std::vector<Entry> Entries;
+
+	bool scan(const std::string &dirname, const std::string &type, std::vector<std::string> *invalid = nullptr);
+	bool add(const std::string &type, const std::string &leafname);
+
+	const Entries *find(const std::string &pkgname) const;
+	const VersionKey *newest(const std::string &pkgname) const;
+
+	void superseded(unsigned int keep, std::vector<Entry> &old_entries) const;
+	void remove(const Entry &entry);
+
+	typedef std::map<std::string, Entries>::const_iterator const_iterator;
+	const_iterator begin() const {return _packages.cbegin();}
+	const_iterator end() const {return _packages.cend();}
+	size_t size() const {return _packages.size();}
+
+private:
+	std::map<std::string, Entries> _packages;
+};
+
+#endif /* PACKAGEVERSIONS_H_ */
@@ -25,6 +25,7 @@
 #include <iostream>
 #include <algorithm>
 #include <memory>
+#include <cstring>
 
 #include "tbx/reporterror.h"
 #include "tbx/path.h"
@@ -34,6 +35,13 @@
 #include "ziparchive/ZipArchive.h"
 #include "ziparchive/ZipException.h"
 #include "RISCOSZipExtra.h"
+#include "ZipReader.h"
+#include "Crc32.h"
+#include "Fnv64.h"
+#include "Sha256.h"
+#include "PackageManifest.h"
+#include "BlobCache.h"
+#include "DigestZipFile.h"
 
 /**
  * Name of package items, must be matched with PackageItem enum
@@ -59,6 +67,31 @@ const char *Packager::_item_names[NUM_ITEMS] = {
   "Components"
 };
 
+/**
+ * Fields of the control record in the order they are written.
+ *
+ * Simple fields give the setter used when the record is read and
+ * the member written out when it isn't empty. Fields that are
+ * split over several members give functions to read and write them.
+ */
+#define CONTROL_FIELD(name) name, sizeof(name)-1
+const Packager::ControlField Packager::_control_fields[] = {
+  {CONTROL_FIELD("Package"), &Packager::package_name, &Packager::_package_name, nullptr, nullptr},
+  {CONTROL_FIELD("Version"), nullptr, nullptr, &Packager::parse_version_field, &Packager::write_version_field},
+  {CONTROL_FIELD("Section"), &Packager::section, &Packager::_section, nullptr, nullptr},
+  {CONTROL_FIELD("Priority"), &Packager::priority, &Packager::_priority, nullptr, nullptr},
+  {CONTROL_FIELD("Maintainer"), &Packager::maintainer, &Packager::_maintainer, nullptr, nullptr},
+  {CONTROL_FIELD("Standards-Version"), &Packager::standards_version, &Packager::_standards_version, nullptr, nullptr},
+  {CONTROL_FIELD("Licence"), &Packager::licence, &Packager::_licence, nullptr, nullptr},
+  {CONTROL_FIELD("Description"), nullptr, nullptr, &Packager::parse_description_field, &Packager::write_description_field},
+  {CONTROL_FIELD("Components"), &Packager::components, nullptr, nullptr, &Packager::write_components_field},
+  {CONTROL_FIELD("Depends"), &Packager::depends, &Packager::_depends, nullptr, nullptr},
+  {CONTROL_FIELD("Recommends"), &Packager::recommends, &Packager::_recommends, nullptr, nullptr},
+  {CONTROL_FIELD("Suggests"), &Packager::suggests, &Packager::_suggests, nullptr, nullptr},
+  {CONTROL_FIELD("Conflicts"), &Packager::conflicts, &Packager::_conflicts, nullptr, nullptr}
+};
+#undef CONTROL_FIELD
+
 /**
  * Special directories found in the package
  */
@@ -97,10 +130,33 @@ public:
 	const std::string &what() const {return message;}
 };
 
+/**
+ * File on disc with its zip name used for comparisons
+ */
+struct DiscListEntry
+{
+	DiscListEntry(const PackageFile *file, std::size_t order) : file(file), order(order) {}
+
+	std::string zip_name;
+	const PackageFile *file;
+	/** Position of the file in the package listing */
+	std::size_t order;
+
+	bool operator<(const DiscListEntry &other) const {return zip_name < other.zip_name;}
+};
+
 
 Packager::Packager() :
+	_copyright_text_valid(false),
 	_modified(false),
-	_error_count(0)
+	_error_count(0),
+	_blob_cache(nullptr),
+	_control_text_valid(false),
+	_lazy_validation(false),
+	_crc_compare(false),
+	_install_to_pending(false),
+	_depends_pending(0),
+	_source_index_valid(true)
 {
     package_name("");
     version("");
@@ -142,8 +198,8 @@ int Packager::next_error(int i) const
 
 void Packager::package_name(std::string value)
 {
-	_package_name = value;
-	if (value.empty())
+	_package_name = std::move(value);
+	if (_package_name.empty())
 	{
 	  set_error(PACKAGE_NAME, "must be entered");
 	} else
@@ -154,8 +210,8 @@ void Packager::package_name(std::string value)
 
 void Packager::version(std::string value)
 {
-	_version = value;
-   if (value.empty())
+	_version = std::move(value);
+   if (_version.empty())
    {
       set_error(VERSION, "must be entered");
    } else
@@ -167,8 +223,8 @@ void Packager::version(std::string value)
 
 void Packager::package_version(std::string value)
 {
-   _package_version = value;
-   if (value.empty())
+   _package_version = std::move(value);
+   if (_package_version.empty())
    {
       set_error(PACKAGE_VERSION, "must be entered");
    } else
@@ -179,8 +235,8 @@ void Packager::package_version(std::string value)
 
 void Packager::section(std::string value)
 {
-   _section = value;
-   if (value.empty())
+   _section = std::move(value);
+   if (_section.empty())
    {
       set_error(SECTION, "must be entered");
    } else
@@ -190,8 +246,8 @@ void Packager::section(std::string value)
 
 void Packager::priority(std::string value)
 {
-   _priority = value;
-   if (value.empty())
+   _priority = std::move(value);
+   if (_priority.empty())
    {
       set_error(PRIORITY, "must be entered");
    } else
@@ -201,14 +257,14 @@ void Packager::priority(std::string value)
 
 void Packager::maintainer (std::string value)
 {
-   _maintainer = value;
-   if (value.empty())
+   _maintainer = std::move(value);
+   if (_maintainer.empty())
    {
       set_error(MAINTAINER, "must be entered");
    } else
    {
-	   std::string::size_type ltpos = value.find('<');
-	   std::string::size_type gtpos = value.find('>');
+	   std::string::size_type ltpos = _maintainer.find('<');
+	   std::string::size_type gtpos = _maintainer.find('>');
 
 	   if (ltpos == std::string::npos || gtpos == std::string::npos)
 		   set_error(MAINTAINER, "Email address must be included and enclosed in '<' and '>'");
@@ -223,8 +279,8 @@ void Packager::maintainer (std::string value)
 
 void Packager::standards_version(std::string value)
 {
-   _standards_version = value;
-   if (value.empty())
+   _standards_version = std::move(value);
+   if (_standards_version.empty())
    {
       set_error(STANDARDS_VERSION, "must be entered");
    } else
@@ -233,8 +289,8 @@ void Packager::standards_version(std::string value)
 	   bool last_dot = true; // Causes required error if first char is a dot.
 	   int dot_count = 0;
 
-	   for (std::string::const_iterator i = value.begin();
-	        i != value.end() && format_ok; ++i)
+	   for (std::string::const_iterator i = _standards_version.begin();
+	        i != _standards_version.end() && format_ok; ++i)
 	   {
 		   if ((*i) == '.')
 		   {
@@ -307,8 +363,8 @@ bool Packager::standards_version_lt(std::string value)
 
 void Packager::summary(std::string value)
 {
-	_summary = value;
-	if (value.empty())
+	_summary = std::move(value);
+	if (_summary.empty())
 	{
 	   set_error(SUMMARY, "must be entered");
 	} else
@@ -318,14 +374,14 @@ void Packager::summary(std::string value)
 
 void Packager::description(std::string description)
 {
-	_description = description;
+	_description = std::move(description);
 	modified(true);
 }
 
 void Packager::licence(std::string licence)
 {
-	_licence = licence;
-	if (licence.empty())
+	_licence = std::move(licence);
+	if (_licence.empty())
 	{
 	   set_error(LICENCE, "must be entered");
 	} else
@@ -336,9 +392,37 @@ void Packager::licence(std::string licence)
 
 void Packager::copyright(std::string value)
 {
-	_copyright = value;
+	_copyright = std::move(value);
+	_copyright_body.reset();
+	_copyright_text_valid = false;
+	_copyright_text.clear();
+
+	if (_copyright.empty())
+	{
+	   set_error(COPYRIGHT, "must be entered");
+	} else
+	   clear_error(COPYRIGHT);
+
+	modified(true);
+}
+
+
+/**
+ * Set the copyright text to a prefix followed by shared text.
+ *
+ * The shared text is not copied so it can be used by many packages.
+ *
+ * @param prefix text for this package, may be empty
+ * @param body shared text to follow the prefix
+ */
+void Packager::copyright(std::string prefix, std::shared_ptr<const std::string> body)
+{
+	_copyright = std::move(prefix);
+	_copyright_body = std::move(body);
+	_copyright_text_valid = false;
+	_copyright_text.clear();
 
-	if (value.empty())
+	if (_copyright.empty() && (!_copyright_body || _copyright_body->empty()))
 	{
 	   set_error(COPYRIGHT, "must be entered");
 	} else
@@ -347,6 +431,25 @@ void Packager::copyright(std::string value)
 	modified(true);
 }
 
+/**
+ * Get the copyright text
+ *
+ * If the copyright has shared text it is joined to the prefix the first
+ * time this is called. Packages are written and compared using the two
+ * parts so this is only needed to show the whole text.
+ *
+ * @returns copyright text including any shared text
+ */
+const std::string &Packager::copyright() const
+{
+	if (!_copyright_body) return _copyright;
+	if (!_copyright_text_valid)
+	{
+		_copyright_text = _copyright + *_copyright_body;
+		_copyright_text_valid = true;
+	}
+	return _copyright_text;
+}
 
 /**
  * Set item to package.
@@ -356,16 +459,34 @@ void Packager::copyright(std::string value)
 void Packager::set_item_to_package(const ItemToPackage &item)
 {
 	clear_error(ITEM_TO_PACKAGE);
-	validate_install_to(item.install_to());
-	for (ItemToPackage &check : _items_to_package)
+	if (_lazy_validation)
+	{
+		_pending_install_to = item.install_to();
+		_install_to_pending = true;
+	} else
+	{
+		validate_install_to(item.install_to());
+	}
+	_tree.clear();
+
+	if (!_source_index_valid)
 	{
-		if (check.source() == item.source())
+		_source_index.clear();
+		for (std::vector<ItemToPackage>::size_type i = 0; i < _items_to_package.size(); i++)
 		{
-			check = item;
-		    modified(true);
-			return;
+			_source_index.insert(std::make_pair(_items_to_package[i].source(), i));
 		}
+		_source_index_valid = true;
+	}
+
+	auto found = _source_index.find(item.source());
+	if (found != _source_index.end())
+	{
+		_items_to_package[found->second] = item;
+	    modified(true);
+		return;
 	}
+	_source_index[item.source()] = _items_to_package.size();
 	_items_to_package.push_back(item);
     modified(true);
 }
@@ -375,6 +496,8 @@ void Packager::set_item_to_package(const ItemToPackage &item)
  */
 void Packager::remove_item_to_package(const std::string &source)
 {
+	_tree.clear();
+	_source_index_valid = false;
 	for(std::vector<ItemToPackage>::iterator it = _items_to_package.begin();
 			it != _items_to_package.end(); ++it)
 	{
@@ -408,13 +531,9 @@ void Packager::validate_install_to(std::string where)
     {
     	std::string::size_type dot_pos = where.find('.');
     	std::string root_dir = (dot_pos == std::string::npos) ? where : where.substr(0, dot_pos);
-    	std::string opts;
     	bool bad = true;
     	for (int id = SD_APPS; id <= SD_SYSTEM && bad; id++)
     	{
-    		if (!opts.empty()) opts += ",";
-    		opts += " ";
-    		opts += SpecialDirs[id];
     		if (tbx::equals_ignore_case(root_dir, SpecialDirs[id]))
     		{
     			bad = false;
@@ -423,7 +542,7 @@ void Packager::validate_install_to(std::string where)
 
     	if (bad)
     	{
-    		set_error(INSTALL_TO, "must start with one of"+opts);
+    		set_error(INSTALL_TO, "must start with one of" + install_roots_text());
     	} else
     	{
     		bool two_dots = false;
@@ -447,29 +566,29 @@ void Packager::validate_install_to(std::string where)
 
 void Packager::depends(std::string value)
 {
-   _depends = value;
-   check_depends(DEPENDS, value);
+   _depends = std::move(value);
+   check_depends(DEPENDS, _depends);
    modified(true);
 }
 
 void Packager::recommends(std::string value)
 {
-   _recommends = value;
-   check_depends(RECOMMENDS, value);
+   _recommends = std::move(value);
+   check_depends(RECOMMENDS, _recommends);
    modified(true);
 }
 
 void Packager::suggests(std::string value)
 {
-   _suggests = value;
-   check_depends(SUGGESTS, value);
+   _suggests = std::move(value);
+   check_depends(SUGGESTS, _suggests);
    modified(true);
 }
 
 void Packager::conflicts(std::string value)
 {
-   _conflicts = value;
-   check_depends(CONFLICTS, value);
+   _conflicts = std::move(value);
+   check_depends(CONFLICTS, _conflicts);
    modified(true);
 }
 
@@ -520,96 +639,87 @@ void Packager::components(std::string value)
 }
 
 /**
- * Check dependency format
+ * List of the directories an item can be installed to for error messages
  */
-void Packager::check_depends(PackageItem where, std::string depends)
+const std::string &Packager::install_roots_text()
 {
-	if (depends.empty())
+	static std::string roots;
+	if (roots.empty())
 	{
-		clear_error(where);
-		return; // Don't need to have a dependency
-	}
-	std::string err;
-	std::string::size_type comma_pos = depends.find(',');
-	std::string::size_type start = 0;
-	while (comma_pos != std::string::npos && err.empty())
-	{
-		err = check_one_dependency(depends.substr(start, comma_pos - start));
-		start = comma_pos + 1;
-		comma_pos = depends.find(',', start);
+		for (int id = SD_APPS; id <= SD_SYSTEM; id++)
+		{
+			if (!roots.empty()) roots += ",";
+			roots += " ";
+			roots += SpecialDirs[id];
+		}
 	}
-	if (err.empty()) err = check_one_dependency(depends.substr(start));
+	return roots;
+}
+
+/**
+ * Check a dependency field, or leave it for validate()
+ * if lazy validation is on.
+ */
+void Packager::check_depends(PackageItem where, const std::string &depends)
+{
+	if (_lazy_validation) _depends_pending |= 1u << (where - DEPENDS);
+	else parse_depends(where, depends);
+}
+
+/**
+ * Parse a dependency field keeping the parsed list
+ * and setting or clearing its error.
+ */
+void Packager::parse_depends(PackageItem where, const std::string &depends)
+{
+	std::string err = Dependency::parse_list(depends, _dependencies[where - DEPENDS]);
 
 	if (err.empty()) clear_error(where);
 	else set_error(where, err);
 }
 
-std::string Packager::check_one_dependency(std::string dep) const
+/**
+ * Turn lazy validation on or off.
+ *
+ * When lazy validation is on the install location of items to package
+ * and the dependency fields are only checked by validate(), so setting
+ * them many times while building a package only checks them once.
+ * The errors are the same as if they had been checked as they were set.
+ *
+ * Turning lazy validation off runs validate().
+ *
+ * @param lazy true to leave validation until validate() is called
+ */
+void Packager::lazy_validation(bool lazy)
 {
-	std::string::const_iterator i = dep.begin();
-	std::string err;
+	if (!lazy) validate();
+	_lazy_validation = lazy;
+}
 
-	while (i != dep.end() && (*i) == ' ') i++;
-	if (i == dep.end())
-	{
-		err = "empty dependency, have you got too many commas";
-	} else if ((*i) == ')')
-	{
-		err = "Extra ')' in a dependency";
-	} else
+/**
+ * Run the validation left by lazy validation.
+ *
+ * This must be called before checking the errors when lazy validation
+ * is on. It is called by save() and promote().
+ */
+void Packager::validate()
+{
+	if (_install_to_pending)
 	{
-		while (i != dep.end() && (*i) != '(' && (*i) != ' ') i++;
-		while (i != dep.end() && (*i) == ' ') i++;
-		if (i != dep.end())
-		{
-			if (*i != '(')
-			{
-				err = "dependency package name must end with a comma or a '('";
-			} else
-			{
-				i++;
-				while (i != dep.end() && (*i) == ' ') i++;
-				if (i == dep.end() || !((*i) == '=' || (*i) == '<' || (*i) == '>'))
-				{
-					err = "version operator '=', '<<', '>>', '<=' or '>=' missing";
-				} else
-				{
-					if ((*i) == '<')
-					{
-						i++;
-						if (i == dep.end() || ((*i) != '<' && (*i) != '='))
-						{
-							err = "'<' must be followed by another '<' or and '='";
-						}
-					} else if ((*i) == '>')
-					{
-						i++;
-						if (i == dep.end() || ((*i) != '>' && (*i) != '='))
-						{
-							err = "'>' must be followed by another '>' or and '='";
-						}
-					}
-					if (err.empty())
-					{
-						if (i != dep.end()) i++;
-						while (i != dep.end() && (*i) == ' ') i++;
-						if (i == dep.end() || (*i) == ')' || (*i) == ',')
-							err = "version number missing";
-						else if ((*i) == '>' || (*i) == '<' || (*i) == '=')
-							err = "extra symbol in version operator";
-					}
-					if (err.empty())
-					{
-						while (i != dep.end() && *i != ')' && (*i) != ' ') i++;
-						while (i != dep.end() && *i == ' ') i++;
-						if (i == dep.end() || *i != ')') err = "missing ')' or a space in the version number";
-					}
-				}
-			}
-		}
+		// Only the last item set decides the install location error
+		validate_install_to(_pending_install_to);
+		_pending_install_to.clear();
+		_install_to_pending = false;
 	}
 
-	return err;
+	if (_depends_pending)
+	{
+		if (_depends_pending & (1u << (DEPENDS - DEPENDS))) parse_depends(DEPENDS, _depends);
+		if (_depends_pending & (1u << (RECOMMENDS - DEPENDS))) parse_depends(RECOMMENDS, _recommends);
+		if (_depends_pending & (1u << (SUGGESTS - DEPENDS))) parse_depends(SUGGESTS, _suggests);
+		if (_depends_pending & (1u << (CONFLICTS - DEPENDS))) parse_depends(CONFLICTS, _conflicts);
+		_depends_pending = 0;
+	}
 }
 
 /**
@@ -617,6 +727,7 @@ std::string Packager::check_one_dependency(std::string dep) const
  */
 void Packager::modified(bool modified)
 {
+	if (modified) _control_text_valid = false;
 	if (_modified != modified)
 	{
 		_modified = modified;
@@ -651,42 +762,75 @@ void Packager::clear_error(PackageItem where)
  */
 void Packager::read_control(const std::string &filename)
 {
-	std::ifstream cf(filename.c_str());
-	read_control(cf);
+	int length = 0;
+	char *buffer = tbx::Path(filename).load_file(&length);
+	if (!buffer) return;
+
+	try
+	{
+		read_control(buffer, length);
+	} catch(...)
+	{
+		delete [] buffer;
+		throw;
+	}
+	delete [] buffer;
+}
+
+/**
+ * Read items from control record in a stream.
+ *
+ * Throws an PackageFormatException if there is a syntax error or
+ * a field type this program doesn't understand
+ */
+void Packager::read_control(std::istream &in)
+{
+	std::string buffer;
+	char block[4096];
+	while (in)
+	{
+		in.read(block, sizeof(block));
+		buffer.append(block, in.gcount());
+	}
+	read_control(buffer.data(), buffer.size());
 }
 
 /**
- * Read items from control record.
+ * Read items from control record held in memory.
  *
  * This is based on read routine from LibPkg
  *
+ * Lines are processed in place, only the field values are copied
+ * into a single string that is reused for each field.
+ *
  * Throws an PackageFormatException if there is a syntax error or
  * a field type this program doesn't understand
  */
-void Packager::read_control(std::istream &in)
+void Packager::read_control(const char *buffer, size_t size)
 {
-	std::string name, value;
+	const char *name = nullptr;
+	size_t name_len = 0;
+	std::string value;
+	const char *line = buffer;
+	const char *buffer_end = buffer + size;
 	bool done=false;
 
-	while (in&&!done)
+	while (line != buffer_end && !done)
 	{
-		// Get line from input stream.
-		std::string line;
-		getline(in,line);
-
-		// Convert to sequence.
-		std::string::const_iterator first=line.begin();
-		std::string::const_iterator last=line.end();
+		// Get line from buffer.
+		const char *first = line;
+		const char *last = first;
+		while (last != buffer_end && *last != '\n') ++last;
+		line = (last == buffer_end) ? last : last + 1;
 
 		// Strip trailing spaces.
 		while ((last!=first)&&isspace(*(last-1))) --last;
 
-
 		if ((first==last)||isspace(*first))
 		{
 			// Line is blank or begins with a space:
 			// Skip leading spaces.
-			std::string::const_iterator p=first;
+			const char *p=first;
 			while ((p!=last)&&isspace(*p)) ++p;
 			if (p==last)
 			{
@@ -697,7 +841,7 @@ void Packager::read_control(std::istream &in)
 			{
 				// Line is a continuation line:
 				// Check whether there is a field to continue.
-				if (name.empty())
+				if (name_len == 0)
 					throw PackageFormatException(
 						"Continuation line not allowed here in RiscPkg/Control");
 
@@ -706,24 +850,25 @@ void Packager::read_control(std::istream &in)
 				if ((p+1==last)&&(*p=='.')) ++p;
 
 				// Append continuation line to field.
-				value+=std::string("\n");
-				value+=std::string(p,last);
+				value+='\n';
+				value.append(p,last);
 			}
 		}
 		else
 		{
-			if (!name.empty()) set_control_field(name, value);
+			if (name_len) set_control_field(name, name_len, value);
 
 			// Line does not begin with a space:
 			// Parse fieldname.
-			std::string::const_iterator p=first;
+			const char *p=first;
 			while ((p!=last)&&(*p!=':'))
 			{
 				if (isspace(*p))
 					throw PackageFormatException("Syntax error in RiscPkg/Control");
 				++p;
 			}
-			name=std::string(first,p);
+			name = first;
+			name_len = p - first;
 
 			// Parse colon at end of fieldname.
 			if ((p!=last)&&(*p==':')) ++p;
@@ -733,80 +878,70 @@ void Packager::read_control(std::istream &in)
 			while ((p!=last)&&isspace(*p)) ++p;
 
 			// Set beginning of value
-			value = std::string(p, last);
-
+			value.assign(p, last);
 		}
 	}
 
-	if (!name.empty()) set_control_field(name, value);
+	if (name_len) set_control_field(name, name_len, value);
 }
 
 /**
  * Set control field with it's value.
  *
+ * @param name field name (not null terminated)
+ * @param name_len length of field name
+ * @param value field value, this may be modified
+ *
  * throws PackageFormatException if this program doesn't understand the field name.
  */
-void Packager::set_control_field(std::string name, std::string value)
+void Packager::set_control_field(const char *name, size_t name_len, std::string &value)
 {
-	if (name.compare("Package") == 0)
-	{
-		package_name(value);
-	} else if (name.compare("Version") == 0)
-	{
-		std::string::size_type rpos = value.rfind('-');
-		if (rpos == std::string::npos)
-		{
-			version(value);
-			package_version("");
-		} else
-		{
-			version(value.substr(0, rpos));
-			package_version(value.substr(rpos+1));
-		}
-	} else if (name.compare("Section") == 0)
-	{
-		section(value);
-	} else if (name.compare("Priority") == 0)
-	{
-		priority(value);
-	} else if (name.compare("Maintainer") == 0)
-	{
-		maintainer(value);
-	} else if (name.compare("Standards-Version") == 0)
+	for (const ControlField &field : _control_fields)
 	{
-		standards_version(value);
-	} else if (name.compare("Description") == 0)
-	{
-		std::string::size_type eolpos = value.find('\n');
-		if (eolpos == std::string::npos)
-		{
-			summary(value);
-		} else
+		if (field.name_len == name_len && std::memcmp(field.name, name, name_len) == 0)
 		{
-			summary(value.substr(0, eolpos));
-			description(value.substr(eolpos+1));
+			if (field.parse) (this->*field.parse)(value);
+			else (this->*field.set)(std::move(value));
+			return;
 		}
-	} else if (name.compare("Licence") == 0)
-	{
-		licence(value);
-	} else if (name.compare("Depends") == 0)
-	{
-	    depends(value);
-	} else if (name.compare("Recommends") == 0)
-	{
-	    recommends(value);
-	} else if (name.compare("Suggests") == 0)
+	}
+
+	throw PackageFormatException("Unable to process field '" + std::string(name, name_len) + "' in RiscPkg/Control");
+}
+
+/**
+ * Split the Version field into the version and package version
+ */
+void Packager::parse_version_field(std::string &value)
+{
+	std::string::size_type rpos = value.rfind('-');
+	if (rpos == std::string::npos)
 	{
-	   suggests(value);
-	} else if (name.compare("Conflicts") == 0)
+		version(std::move(value));
+		package_version("");
+	} else
 	{
-	   conflicts(value);
-	} else if (name.compare("Components") == 0)
+		std::string pkg_version(value, rpos+1);
+		value.resize(rpos);
+		version(std::move(value));
+		package_version(std::move(pkg_version));
+	}
+}
+
+/**
+ * Split the Description field into the summary and description
+ */
+void Packager::parse_description_field(std::string &value)
+{
+	std::string::size_type eolpos = value.find('\n');
+	if (eolpos == std::string::npos)
 	{
-		components(value);
+		summary(std::move(value));
 	} else
 	{
-		throw PackageFormatException("Unable to process field '" + name + "' in RiscPkg/Control");
+		summary(value.substr(0, eolpos));
+		value.erase(0, eolpos+1);
+		description(std::move(value));
 	}
 }
 
@@ -891,7 +1026,7 @@ void Packager::set_install_item(std::string &install_item, const std::string &it
 /**
  * Convert filename from within a zip to a RISC OS filename
  */
-std::string Packager::zip_to_riscos_name(const std::string &zipname) const
+std::string Packager::zip_to_riscos_name(const std::string &zipname)
 {
 	std::string roname(zipname);
 	std::string::size_type pos = 0;
@@ -907,7 +1042,7 @@ std::string Packager::zip_to_riscos_name(const std::string &zipname) const
 /**
  * Convert a RISC OS filename  to filename within a zip
  */
-std::string Packager::riscos_to_zip_name(const std::string &riscosname) const
+std::string Packager::riscos_to_zip_name(const std::string &riscosname)
 {
 	// Currently the transformation is identical, but it
 	// may change in future.
@@ -920,318 +1055,591 @@ std::string Packager::riscos_to_zip_name(const std::string &riscosname) const
  *
  * @param filename file name to save package as
  * @param error option string to be updated with any error message
+ * @param digests optional size and digests calculated as the package is written
  *
  * returns true if successful
  */
-bool Packager::save(std::string filename, std::string *error /*=nullptr*/)
+bool Packager::save(std::string filename, std::string *error /*=nullptr*/, PackageDigests *digests /*=nullptr*/)
 {
-	CZipArchive zip;
-	bool ok = false;
-
-	if (error) error->clear();
-
-	try
-	{
-		zip.Open(filename.c_str(), CZipArchive::zipCreate);
-
-		write_control(zip);
-		write_copyright(zip);
-
-		for (ItemToPackage &item_to_package : _items_to_package)
-		{
-			tbx::Path files(item_to_package.source());
-
-			// Set size of base file name so it can be removed from zip filenames
-			_base_dir_size = files.parent().name().length() + 1;
-			std::vector<std::pair<tbx::Path, tbx::PathInfo> > file_list;
-
-			tbx::PathInfo root_info;
-			if (!files.path_info(root_info))
-			{
-				std::string msg("Unable to read file/directory ");
-				msg += item_to_package.source();
-				throw PackageCreateException(msg);
-			}
-
-			if (root_info.directory())
-			{
-				get_file_list(files, file_list);
-			} else
-			{
-			    if (root_info.image_file())
-			    {
-			       // Image file systems don't by default give a file type
-			       // so re-read it and calculate
-			       files.raw_path_info(root_info, true);
-			    }
-				file_list.push_back(std::pair<tbx::Path, tbx::PathInfo>(files, root_info));
-			}
-
-			unsigned int last_percent = 2;
-			unsigned int total_files = file_list.size();
-
-			for (unsigned int i = 0; i != total_files; i++)
-			{
-				copy_file(zip, file_list[i].first, file_list[i].second, item_to_package.install_to());
-				unsigned int pc = i * 100 / total_files;
-				if (pc > last_percent)
-				{
-					last_percent = pc;
-				}
-			}
-		}
-
-		zip.Close();
-
-	    ok = true;
-
-	} catch(CZipException &e)
-	{
-		std::string errmsg("Failed to create zip file: ");
-		std::string desc =e.GetErrorDescription();
-		errmsg += desc;
-		if (error) *error = errmsg;tbx::report_error(errmsg.c_str());
-	} catch(PackageCreateException &e)
-	{
-		if (error) *error = e.what();
-	} catch(std::bad_alloc &bae)
-	{
-		if (error) *error = "Unable to allocate enough memory to create package";
-	} catch(...)
-	{
-		if (error) *error = "Unexpected exception thrown during package creation";
-	}
+	validate();
+	return write_package(filename, nullptr, 0, error, digests);
+}
 
-	return ok;
+/**
+ * Save the package taking the files from an existing package instead
+ * of from disc.
+ *
+ * The compressed data for each file is copied directly from the existing
+ * package so nothing is recompressed. Only the control record and copyright
+ * are written from this package. This should only be used if the files
+ * on disc are the same as the files in the existing package.
+ *
+ * @param from_pkgfile full path of existing package to copy the files from
+ * @param filename file name to save package as
+ * @param error option string to be updated with any error message
+ * @param digests optional size and digests updated once the package is written
+ *
+ * returns true if successful
+ */
+bool Packager::promote(const std::string &from_pkgfile, std::string filename, std::string *error /*=nullptr*/, PackageDigests *digests /*=nullptr*/)
+{
+	validate();
+	return write_package(filename, &from_pkgfile, COPY_ALL_FILES, error, digests);
 }
 
 /**
- * Return text of the control file
+ * Save the package only if its files are different to the files in the
+ * last version of the package.
  *
- * @return control text
+ * The files are compared with the last package in the order they are
+ * packaged. When a difference is found the files before it are copied
+ * from the last package without being compressed again, so the work of
+ * comparing them is not thrown away. A package that has not changed is
+ * never built or written.
+ *
+ * The control record and copyright are not compared, so they should
+ * be checked before this is called.
+ *
+ * @param filename file name to save package as if it has changed
+ * @param last_pkgfile full path of the last version of the package
+ * @param last_list files in the last package sorted by name or nullptr
+ * to read them from the package
+ * @param changed updated to true if the files have changed and the package was saved
+ * @param diff optional string updated with the first difference found
+ * @param error option string to be updated with any error message
+ * @param digests optional size and digests updated once the package is written
+ *
+ * returns true if successful
  */
-std::string Packager::control_as_text() const
+bool Packager::save_if_changed(std::string filename, const std::string &last_pkgfile, const std::vector<ZipEntry> *last_list,
+		bool &changed, std::string *diff /*=nullptr*/, std::string *error /*=nullptr*/, PackageDigests *digests /*=nullptr*/)
 {
-	std::ostringstream os;
+	validate();
+	changed = true;
+	if (!scan_files(error)) return false;
 
-	if (!_package_name.empty())
-	    os << "Package: " << _package_name << std::endl;
-	if (!_version.empty())
-	    os << "Version: " << _version << "-" << _package_version << std::endl;
-	if (!_section.empty())
-	    os << "Section: " << _section << std::endl;
-	if (!_priority.empty())
-	     os << "Priority: " << _priority << std::endl;
-	if (!_maintainer.empty())
-	   os << "Maintainer: " << _maintainer << std::endl;
-	if (!_standards_version.empty())
-	   os << "Standards-Version: " << _standards_version << std::endl;
-	if (!_licence.empty())
-	   os << "Licence: " << _licence << std::endl;
-	if (!_summary.empty())
-		os << "Description: " << _summary << std::endl;
-	if (!_description.empty())
+	ZipReader zip_reader;
+	std::vector<ZipEntry> read_list;
+	if (!last_list)
 	{
-	    if (_summary.empty()) os << "Description: ";
-  		std::string::size_type solpos = 0, eolpos, wspos;
-  		int blank_line = 0;
-		while (solpos < _description.size()
-			&& (eolpos = _description.find('\n', solpos))!=std::string::npos
-			)
+		if (!zip_reader.open(last_pkgfile))
 		{
-			wspos = solpos;
-			while (wspos < eolpos && _description[wspos] == ' ') wspos++;
-			if (eolpos == wspos) blank_line++;
-			else
-			{
-				while (blank_line > 0) { blank_line--; os << " ." << std::endl;}
-			    os << " " << _description.substr(solpos, eolpos - solpos) << std::endl;
-			}
-			solpos = eolpos+1;
+			if (diff) *diff = last_pkgfile + " does not exist";
+			return write_package(filename, nullptr, 0, error, digests);
 		}
-		if (solpos < _description.size())
+		sorted_zip_list(zip_reader, read_list);
+		last_list = &read_list;
+	}
+
+	// Count the files at the start of the package that are unchanged
+	std::size_t same_count = 0;
+	CZipArchive zip_compare;
+	std::string disc_name, zip_name;
+	for (const PackageFile &file : _tree)
+	{
+		_tree.disc_name(file, disc_name);
+		_tree.zip_name(file, zip_name);
+		const ZipEntry *zip_entry = find_zip_entry(*last_list, zip_name);
+		if (!zip_entry)
+		{
+			if (diff) *diff = "new file " + disc_name;
+			break;
+		}
+		if (zip_entry->size != file.length)
 		{
-			while (blank_line > 0) { blank_line--; os << " ." << std::endl;}
-			os << " "  << _description.substr(solpos) << std::endl;
+			if (diff) *diff = "file size changed " + disc_name;
+			break;
 		}
+		if (!file_is_same(zip_reader, zip_compare, last_pkgfile, disc_name, *zip_entry, diff)) break;
+		same_count++;
 	}
+	close_zip_compare(zip_compare);
+	zip_reader.close();
 
-	bool write_comps = true;
-	for (const ItemToPackage &item_to_package : _items_to_package)
+	if (same_count == _tree.size())
 	{
-		if (item_to_package.component_flags() != CF_None)
+		std::size_t last_count = last_list->size();
+		if (find_zip_entry(*last_list, "RiscPkg/Control")) last_count--;
+		if (find_zip_entry(*last_list, "RiscPkg/Copyright")) last_count--;
+		if (last_count == same_count)
 		{
-			if (write_comps)
-			{
-				os << "Components: ";
-				write_comps = false;
-			} else
-			{
-				os << ",";
-			}
-
-			os << item_to_package.component() << " (Movable";
-			if (item_to_package.component_flags() & CF_Run) os << " Run";
-			os << ")";
+			changed = false;
+			return true;
 		}
+		if (diff) *diff = tbx::to_string((int)(last_count - same_count)) + " files removed";
 	}
-	if (!write_comps) os << std::endl;
-
-    if (!_depends.empty())
-      os << "Depends: " << _depends << std::endl;
-    if (!_recommends.empty())
-      os << "Recommends: " << _recommends << std::endl;
-    if (!_suggests.empty())
-      os << "Suggests: " << _suggests << std::endl;
-    if (!_conflicts.empty())
-      os << "Conflicts: " << _conflicts << std::endl;
 
-    return os.str();
+	return write_package(filename, &last_pkgfile, same_count, error, digests);
 }
 
 /**
- * Write control record to given stream
+ * Write the package to a file
+ *
+ * @param filename file name to save package as
+ * @param copy_from package to copy the file data from or nullptr to read from disc
+ * @param copy_count number of files to copy from copy_from (see create_package)
+ * @param error option string to be updated with any error message
+ * @param digests optional size and digests updated once the package is written
+ *
+ * returns true if successful
  */
-void Packager::write_control(CZipArchive &zip) const
+bool Packager::write_package(const std::string &filename, const std::string *copy_from, std::size_t copy_count, std::string *error, PackageDigests *digests) const
 {
+	if (!digests) return create_package(filename, nullptr, copy_from, copy_count, error);
 
-	write_text_file(zip, "RiscPkg/Control", control_as_text());
-}
+	CZipFile file;
+	if (!file.Open(filename.c_str(), CZipFile::modeCreate | CZipFile::modeReadWrite, false))
+	{
+		if (error) *error = "Unable to create package file " + filename;
+		return false;
+	}
 
+	// The digests are calculated from the data as it is written so
+	// the package does not have to be read again
+	DigestZipFile digest_file(&file);
+	if (!create_package(filename, &digest_file, copy_from, copy_count, error)) return false;
+
+	if (digest_file.valid())
+	{
+		digests->size = digest_file.GetLength();
+		digests->md5 = digest_file.md5_digest();
+		digests->sha256 = digest_file.sha256_digest();
+		digests->read_stamp(filename);
+	} else if (!digests->calculate(filename))
+	{
+		// Only read back if the zip changed data already in the digests
+		if (error) *error = "Unable to read package file " + filename + " for digests";
+		return false;
+	}
+	digests->control_fingerprint = control_fingerprint();
+	digests->copyright_fingerprint = copyright_fingerprint();
+	digests->fingerprints_known = true;
+
+	return true;
+}
 
 /**
- * Write the copyright file
+ * Check if the package that would be created is identical to an
+ * existing package.
+ *
+ * The SHA-256 digest of the package is calculated as it is built
+ * and compared with the digest of the existing package file, so
+ * nothing is written to disc.
+ *
+ * As packages are built reproducibly this will only show a difference
+ * if the contents or metadata of the package have changed or the existing
+ * package was not created by this program.
+ *
+ * @param pkgfilename full path to package to compare to
+ * @param diff optional string to give reason packages were different
+ * @returns true if the packages are the same
  */
-void Packager::write_copyright(CZipArchive &zip) const
+bool Packager::same_digest_as(const std::string &pkgfilename, std::string *diff /* = nullptr */) const
 {
-	write_text_file(zip, "RiscPkg/Copyright", _copyright.c_str());
+	std::string old_digest;
+	if (!Sha256::of_file(pkgfilename, old_digest))
+	{
+		if (diff) *diff = pkgfilename + " does not exist";
+		return false;
+	}
+
+	return same_digest(old_digest, diff);
 }
 
 /**
- * Write a text file with the given text to the zip file
+ * Check if the package that would be created has the given digest
+ *
+ * @param old_digest SHA-256 digest of the existing package in hexadecimal
+ * @param diff optional string to give reason packages were different
+ * @returns true if the packages are the same
  */
-void Packager::write_text_file(CZipArchive &zip, const char *filename, std::string text) const
+bool Packager::same_digest(const std::string &old_digest, std::string *diff /* = nullptr */) const
 {
-	CZipFileHeader fhead;
-	fhead.SetFileName(filename);
-	fhead.SetModificationTime(time(NULL));
+	std::string new_digest;
+	if (!package_digest(new_digest, diff)) return false;
 
-	RISCOSZipExtra textextra(0xFFF);
+	if (new_digest != old_digest)
+	{
+		if (diff) *diff = "package digest changed";
+		return false;
+	}
 
-    // Local entry
-	CZipExtraData *extra = fhead.m_aLocalExtraData.CreateNew(textextra.tag());
-    extra->m_data.Allocate(textextra.size());
-	memcpy(extra->m_data, textextra.buffer(), textextra.size());
-	// Central directory entry
-	extra = fhead.m_aCentralExtraData.CreateNew(textextra.tag());
-    extra->m_data.Allocate(textextra.size());
-	memcpy(extra->m_data, textextra.buffer(), textextra.size());
+	return true;
+}
 
-	zip.OpenNewFile(fhead);
-	zip.WriteNewFile(text.c_str(), text.size());
-	zip.CloseNewFile();
+/**
+ * Calculate the SHA-256 digest of the package that would be saved.
+ *
+ * @param digest updated with the digest in hexadecimal
+ * @param error optional string to be updated with any error message
+ * @returns true if the digest was calculated
+ */
+bool Packager::package_digest(std::string &digest, std::string *error /*=nullptr*/) const
+{
+	// Each entry is discarded once it has been added to the digest so
+	// only the largest entry is ever held in memory
+	DigestZipFile digest_file;
+	if (!create_package(std::string(), &digest_file, nullptr, 0, error)) return false;
+	if (!digest_file.valid())
+	{
+		if (error) *error = "Unable to calculate package digest";
+		return false;
+	}
+
+	digest = digest_file.sha256_digest();
+	return true;
 }
 
 /**
- * Get list of files to copy
+ * Create the package
+ *
+ * The output is reproducible. Entries are written in a fixed order
+ * and every date stamp comes from the files being packaged or is the
+ * fixed package_time().
  *
- * Recurses down directories
+ * @param filename file name to save package as. If digest_file is not
+ * nullptr this is only used to read back files to add to the blob cache
+ * and can be empty to skip adding them.
+ * @param digest_file file to write the package to or nullptr to write
+ * to filename. It is committed after each entry and closed at the end.
+ * @param copy_from package to copy the compressed files from or nullptr
+ * to compress them from disc
+ * @param copy_count number of files at the start of the package to copy
+ * from copy_from, the rest are compressed from disc. COPY_ALL_FILES copies
+ * every file in copy_from. Any other non-zero count needs the files to
+ * have been read by scan_files.
+ * @param error option string to be updated with any error message
+ * @returns true if successful
  */
-void Packager::get_file_list(const tbx::Path &dirname, std::vector<std::pair<tbx::Path, tbx::PathInfo> > &file_list) const
+bool Packager::create_package(const std::string &filename, DigestZipFile *digest_file, const std::string *copy_from, std::size_t copy_count, std::string *error) const
 {
-	std::vector<std::string> dirnames;
+	CZipArchive zip;
+	bool ok = false;
 
-	for (tbx::PathInfo::Iterator i = tbx::PathInfo::begin(dirname, "*");
-	        i != tbx::PathInfo::end(); ++i)
+	if (error) error->clear();
+
+	try
 	{
-		tbx::PathInfo entry(*i);
+		std::time_t modified = package_time();
+
+		auto entry_done = [digest_file]()
+		{
+			if (digest_file) digest_file->commit();
+		};
+
+		if (digest_file) zip.Open(*digest_file, CZipArchive::zipCreate);
+		else zip.Open(filename.c_str(), CZipArchive::zipCreate);
+
+		write_control(zip, modified);
+		entry_done();
+		write_copyright(zip, modified);
+		entry_done();
 
-		if (entry.directory())
+		if (copy_from && copy_count == COPY_ALL_FILES)
 		{
-			// Go down directories after processing all files
-			dirnames.push_back(entry.name());
+			CZipArchive from_zip;
+			from_zip.Open(copy_from->c_str(), CZipArchive::zipOpenReadOnly);
+			ZIP_INDEX_TYPE count = from_zip.GetCount();
+			for (ZIP_INDEX_TYPE index = 0; index < count; index++)
+			{
+				std::string name(from_zip.GetFileInfo(index)->GetFileName());
+				if (name != "RiscPkg/Control" && name != "RiscPkg/Copyright")
+				{
+					zip.GetFromArchive(from_zip, index);
+					entry_done();
+				}
+			}
+			from_zip.Close();
 		} else
 		{
-			tbx::Path filename(dirname , entry.name());
-			file_list.push_back(std::pair<tbx::Path, tbx::PathInfo>(filename, entry));
+			CZipArchive from_zip;
+			if (copy_from && copy_count)
+			{
+				from_zip.Open(copy_from->c_str(), CZipArchive::zipOpenReadOnly);
+				from_zip.EnableFindFast(true);
+			} else
+			{
+				copy_count = 0;
+			}
+
+			// Files not in the cache are added to it after the zip is closed
+			bool use_cache = (_blob_cache && _blob_cache->is_open() && !filename.empty());
+			std::vector<std::pair<std::string, std::string> > cache_misses;
+			std::string key;
+			auto add_file = [&](const PackageFile &file, const std::string &disc_name, const std::string &zip_name)
+			{
+				if (use_cache
+					&& BlobCache::key(disc_name, file.extra, file.dated ? file.modified : modified, -1, key))
+				{
+					if (_blob_cache->copy_to(zip, key, zip_name))
+					{
+						entry_done();
+						return;
+					}
+					cache_misses.push_back(std::make_pair(zip_name, key));
+				}
+				copy_file(zip, file, disc_name, zip_name, modified);
+				entry_done();
+			};
+
+			if (_tree.built())
+			{
+				// Use files already read for the comparison with the last package
+				std::string disc_name, zip_name;
+				std::size_t file_count = 0;
+				for (const PackageFile &file : _tree)
+				{
+					_tree.zip_name(file, zip_name);
+					if (file_count++ < copy_count)
+					{
+						ZIP_INDEX_TYPE index = from_zip.FindFile(zip_name.c_str(), CZipArchive::ffCaseSens);
+						if (index == ZIP_FILE_INDEX_NOT_FOUND)
+						{
+							throw PackageCreateException(zip_name + " missing from " + *copy_from);
+						}
+						zip.GetFromArchive(from_zip, index);
+						entry_done();
+					} else
+					{
+						_tree.disc_name(file, disc_name);
+						add_file(file, disc_name, zip_name);
+					}
+				}
+			} else
+			{
+				// Files are compressed as each directory is read so the
+				// whole tree never has to be held in memory
+				std::string scan_error;
+				if (!PackageTree::scan(_items_to_package,
+						[&add_file](const PackageFile &file, const PackageFileNames &names)
+						{
+							add_file(file, names.disc_name, names.zip_name);
+						},
+						&scan_error))
+				{
+					throw PackageCreateException(scan_error);
+				}
+			}
+			if (copy_count) from_zip.Close();
+
+			if (!cache_misses.empty())
+			{
+				zip.Close();
+				if (digest_file) digest_file->Close();
+				zip.Open(filename.c_str(), CZipArchive::zipOpenReadOnly);
+				zip.EnableFindFast(true);
+				for (auto &miss : cache_misses)
+				{
+					_blob_cache->add(zip, miss.first, miss.second);
+				}
+			}
 		}
-	}
 
-	std::vector<std::string>::iterator i;
-	for (i = dirnames.begin(); i != dirnames.end(); ++i)
+		zip.Close();
+		if (digest_file) digest_file->Close();
+
+	    ok = true;
+
+	} catch(CZipException &e)
 	{
-		tbx::Path subdirname(dirname, (*i));
-		get_file_list(subdirname, file_list);
+		std::string errmsg("Failed to create zip file: ");
+		std::string desc =e.GetErrorDescription();
+		errmsg += desc;
+		if (error) *error = errmsg;tbx::report_error(errmsg.c_str());
+	} catch(PackageCreateException &e)
+	{
+		if (error) *error = e.what();
+	} catch(std::bad_alloc &bae)
+	{
+		if (error) *error = "Unable to allocate enough memory to create package";
+	} catch(...)
+	{
+		if (error) *error = "Unexpected exception thrown during package creation";
 	}
+
+	return ok;
 }
 
 /**
- * Copy files from specified directory to zip file.
+ * Return text of the control file
+ *
+ * The text is built once and kept until the package is modified.
+ *
+ * @return control text
  */
-void Packager::copy_files(CZipArchive &zip, const tbx::Path &dirname, const std::string &install_to) const
+const std::string &Packager::control_as_text() const
 {
-	std::vector<std::string> dirnames;
+	if (_control_text_valid) return _control_text;
 
-	for (tbx::PathInfo::Iterator i = tbx::PathInfo::begin(dirname, "*");
-	        i != tbx::PathInfo::end(); ++i)
+	_control_text.clear();
+	for (const ControlField &field : _control_fields)
 	{
-		tbx::PathInfo entry(*i);
-		if (entry.directory())
+		if (field.write)
 		{
-			// Go down directories after processing all files
-			dirnames.push_back(entry.name());
+			(this->*field.write)(_control_text);
 		} else
 		{
-			tbx::Path filename(dirname , entry.name());
-			copy_file(zip, filename, entry, install_to);
+			const std::string &value = this->*field.value;
+			if (!value.empty())
+			{
+				_control_text.append(field.name, field.name_len).append(": ").append(value) += '\n';
+			}
 		}
 	}
+	_control_text_valid = true;
+
+	return _control_text;
+}
 
-	std::vector<std::string>::iterator i;
-	for (i = dirnames.begin(); i != dirnames.end(); ++i)
+/**
+ * Add the Version field to the control text
+ */
+void Packager::write_version_field(std::string &text) const
+{
+	if (!_version.empty())
+		text.append("Version: ").append(_version).append("-").append(_package_version) += '\n';
+}
+
+/**
+ * Add the Description field to the control text
+ */
+void Packager::write_description_field(std::string &text) const
+{
+	if (!_summary.empty())
+		text.append("Description: ").append(_summary) += '\n';
+	if (!_description.empty())
 	{
-		tbx::Path subdirname(dirname, (*i));
-		copy_files(zip, subdirname, install_to);
+	    if (_summary.empty()) text.append("Description: ");
+  		std::string::size_type solpos = 0, eolpos, wspos;
+  		int blank_line = 0;
+		while (solpos < _description.size()
+			&& (eolpos = _description.find('\n', solpos))!=std::string::npos
+			)
+		{
+			wspos = solpos;
+			while (wspos < eolpos && _description[wspos] == ' ') wspos++;
+			if (eolpos == wspos) blank_line++;
+			else
+			{
+				while (blank_line > 0) { blank_line--; text.append(" .\n");}
+				text += ' ';
+				text.append(_description, solpos, eolpos - solpos) += '\n';
+			}
+			solpos = eolpos+1;
+		}
+		if (solpos < _description.size())
+		{
+			while (blank_line > 0) { blank_line--; text.append(" .\n");}
+			text += ' ';
+			text.append(_description, solpos, std::string::npos) += '\n';
+		}
 	}
 }
 
 /**
- * Copy a single file to the archive
+ * Add the Components field to the control text
  */
-void Packager::copy_file(CZipArchive &zip, const tbx::Path &filename, const std::string &install_to) const
+void Packager::write_components_field(std::string &text) const
 {
-	tbx::PathInfo entry;
-	filename.path_info(entry);
+	bool write_comps = true;
+	for (const ItemToPackage &item_to_package : _items_to_package)
+	{
+		if (item_to_package.component_flags() != CF_None)
+		{
+			if (write_comps)
+			{
+				text.append("Components: ");
+				write_comps = false;
+			} else
+			{
+				text += ',';
+			}
 
-	copy_file(zip, filename, entry, install_to);
+			text.append(item_to_package.component()).append(" (Movable");
+			if (item_to_package.component_flags() & CF_Run) text.append(" Run");
+			text += ')';
+		}
+	}
+	if (!write_comps) text += '\n';
 }
 
 /**
- * Copy a single file and its attribute to the archive
+ * Get the date stamp used for the files in the package that do not
+ * have one of their own.
+ *
+ * This is fixed so rebuilding a package from the same files always
+ * gives the same result and it is known before any files are read.
+ *
+ * @returns modification time for the control record, copyright and undated files
+ */
+std::time_t Packager::package_time()
+{
+	// 2 Jan 1980 UTC. Zip files can not store times before 1 Jan 1980
+	// local time so this leaves a day for any time zone.
+	return 315619200;
+}
+
+/**
+ * Write control record to given stream
  */
-void Packager::copy_file(CZipArchive &zip, const tbx::Path &filename, tbx::PathInfo &entry, const std::string &install_to) const
+void Packager::write_control(CZipArchive &zip, std::time_t modified) const
 {
-	// swap "." and slashes in name to put in zip file
-	std::string nameinzip = install_to + "." + filename.name().substr(_base_dir_size);
-	nameinzip = riscos_to_zip_name(nameinzip);
 
+	write_text_file(zip, "RiscPkg/Control", control_as_text(), nullptr, modified);
+}
+
+
+/**
+ * Write the copyright file
+ */
+void Packager::write_copyright(CZipArchive &zip, std::time_t modified) const
+{
+	write_text_file(zip, "RiscPkg/Copyright", _copyright, _copyright_body.get(), modified);
+}
+
+/**
+ * Write a text file with the given text to the zip file
+ */
+void Packager::write_text_file(CZipArchive &zip, const char *filename, const std::string &text, const std::string *more_text, std::time_t modified) const
+{
 	CZipFileHeader fhead;
-	fhead.SetFileName(nameinzip.c_str());
+	fhead.SetFileName(filename);
+	fhead.SetModificationTime(modified);
 
-	if (entry.has_file_type())
-	{
-		long long csecs_since_1900 = entry.modified_time().centiseconds();
-		long long secs_between = 25567; // days
-		secs_between *= 24 * 60 * 60; // seconds
-		time_t secs_since_1970 = (time_t)(csecs_since_1900/100 - secs_between);
+	RISCOSZipExtra textextra(0xFFF, modified);
+
+    // Local entry
+	CZipExtraData *extra = fhead.m_aLocalExtraData.CreateNew(textextra.tag());
+    extra->m_data.Allocate(textextra.size());
+	memcpy(extra->m_data, textextra.buffer(), textextra.size());
+	// Central directory entry
+	extra = fhead.m_aCentralExtraData.CreateNew(textextra.tag());
+    extra->m_data.Allocate(textextra.size());
+	memcpy(extra->m_data, textextra.buffer(), textextra.size());
+
+	zip.OpenNewFile(fhead);
+	zip.WriteNewFile(text.c_str(), text.size());
+	if (more_text) zip.WriteNewFile(more_text->c_str(), more_text->size());
+	zip.CloseNewFile();
+}
+
+/**
+ * Copy a single file and its attribute to the archive
+ */
+void Packager::copy_file(CZipArchive &zip, const PackageFile &file, const std::string &disc_name, const std::string &zip_name, std::time_t undated_time) const
+{
+	CZipFileHeader fhead;
+	fhead.SetFileName(zip_name.c_str());
 
-		fhead.SetModificationTime(secs_since_1970);
+	if (file.dated)
+	{
+		fhead.SetModificationTime(file.modified);
 	} else
 	{
-	    fhead.SetModificationTime(time(NULL));
+	    fhead.SetModificationTime(undated_time);
 	}
 
-	RISCOSZipExtra extra(entry);
+	RISCOSZipExtra extra(file.extra);
 
     // Local filetype extra data
 	CZipExtraData *extra_data = fhead.m_aLocalExtraData.CreateNew(extra.tag());
@@ -1245,10 +1653,10 @@ void Packager::copy_file(CZipArchive &zip, const tbx::Path &filename, tbx::PathI
 	zip.OpenNewFile(fhead);
 
 	/* Copy file data */
-	int filesize = entry.length();
+	int filesize = file.length;
 	if (filesize > 0)
 	{
-		std::ifstream from_file(filename.name().c_str());
+		std::ifstream from_file(disc_name.c_str());
 		while (filesize > copy_buffer_size)
 		{
 			from_file.read(copy_buffer, copy_buffer_size);
@@ -1346,83 +1754,176 @@ std::string Packager::standard_leafname() const
  */
 bool Packager::same_as(const std::string &pkgfilename, std::string *diff /* = nullptr */) const
 {
-	CZipArchive zip_compare;
-	if (!zip_compare.Open(pkgfilename.c_str(), CZipArchive::OpenMode::zipOpenReadOnly))
+	ZipReader zip_reader;
+	if (!zip_reader.open(pkgfilename))
 	{
 		// Not the same if the old file doesn't exist
 		if (diff) *diff = pkgfilename + " does not exist";
 		return false;
 	}
 
-    std::map<std::string, int> zip_contents;
-    int num_objects = zip_compare.GetCount();
-    for (int i = 0; i < num_objects; ++i)
-    {
-    	CZipFileHeader *fileInfo = zip_compare.GetFileInfo(i);
-    	if (!fileInfo->IsDirectory())
-    	{
-    		zip_contents[fileInfo->GetFileName()] = fileInfo->m_uUncomprSize;
-    	}
-    }
+	// Sorted list of the files in the zip, read straight from the central directory
+    std::vector<ZipEntry> zip_list;
+    sorted_zip_list(zip_reader, zip_list);
 
-    // First check control/copyright content size changes
-    if (!compare_file_text_size(zip_contents, "RiscPkg/Copyright", _copyright, diff))
-    {
-    	return false;
-    }
+    CZipArchive zip_compare;
+    bool same = same_metadata(zip_list, zip_compare, pkgfilename, diff)
+    		&& same_contents(zip_list, zip_reader, zip_compare, pkgfilename, diff);
+    close_zip_compare(zip_compare);
 
-    std::string control = control_as_text();
-    if (!compare_file_text_size(zip_contents, "RiscPkg/Control", control, diff))
-    {
-    	return false;
-    }
+    return same;
+}
 
-    // Now check control/copyright for content changes
-    if (!file_text_is_same(zip_compare, "RiscPkg/Copyright", _copyright, diff))
-    {
-    	return false;
-    }
+/**
+ * Compare the files for this package with an existing package using
+ * a list of its contents that has already been read.
+ *
+ * The package file is only opened if file contents need to be
+ * compared, which is only for stored files when crc_compare is set.
+ *
+ * @param zip_list files in the existing package sorted by name
+ * @param pkgfilename full path to package to compare to
+ * @param diff optional string to give reason packages were different
+ * @returns true if the packages are the same
+ */
+bool Packager::same_as(const std::vector<ZipEntry> &zip_list, const std::string &pkgfilename, std::string *diff /* = nullptr */) const
+{
+	ZipReader zip_reader;
+	CZipArchive zip_compare;
+	bool same = same_metadata(zip_list, zip_compare, pkgfilename, diff)
+			&& same_contents(zip_list, zip_reader, zip_compare, pkgfilename, diff);
+	close_zip_compare(zip_compare);
 
-    if (!file_text_is_same(zip_compare, "RiscPkg/Control", control, diff))
-    {
-    	return false;
-    }
+	return same;
+}
 
-    // No longer interested in these two files
-    zip_contents.erase("RiscPkg/Copyright");
-    zip_contents.erase("RiscPkg/Control");
+/**
+ * Compare the files on disc for this package with the contents of an existing
+ * package ignoring the control record and copyright.
+ *
+ * @param zip_list files in the existing package sorted by name
+ * @param pkgfilename full path to package to compare to
+ * @param diff optional string to give reason packages were different
+ * @returns true if the files are the same
+ */
+bool Packager::same_files_as(const std::vector<ZipEntry> &zip_list, const std::string &pkgfilename, std::string *diff /* = nullptr */) const
+{
+	ZipReader zip_reader;
+	CZipArchive zip_compare;
+	bool same = same_contents(zip_list, zip_reader, zip_compare, pkgfilename, diff);
+	close_zip_compare(zip_compare);
 
+	return same;
+}
 
-    // Map of disc file to package file
-    std::map<std::string, std::string> disc_file_list;
+/**
+ * Compare the files on disc for this package with the contents of an existing package
+ *
+ * @param zip_list files in the existing package sorted by name
+ * @param zip_reader reader for the package, opened when it is needed if it isn't already
+ * @param zip_compare archive to decompress files from, opened when it is needed
+ * @param pkgfilename full path to package to compare to
+ * @param diff optional string to give reason packages were different
+ * @returns true if the packages are the same
+ */
+bool Packager::same_contents(const std::vector<ZipEntry> &zip_list, ZipReader &zip_reader, CZipArchive &zip_compare, const std::string &pkgfilename, std::string *diff) const
+{
+    const ZipEntry *zip_copyright = find_zip_entry(zip_list, "RiscPkg/Copyright");
+    const ZipEntry *zip_control = find_zip_entry(zip_list, "RiscPkg/Control");
 
+    if (!scan_files(diff)) return false;
 
-    // Quick check for existence/file sizes - building list of files on disc
-    for (ItemToPackage const &item : _items_to_package)
+    // Sorted list of files on disc
+    std::vector<DiscListEntry> disc_list;
+    disc_list.reserve(_tree.size());
+    for (const PackageFile &file : _tree)
     {
-    	std::string zip_install_to = item.install_to() + "." + tbx::Path(item.source()).leaf_name();
-    	if (!build_disc_list(disc_file_list, zip_contents, item.source(), riscos_to_zip_name(zip_install_to), diff))
+    	disc_list.push_back(DiscListEntry(&file, disc_list.size()));
+    	_tree.zip_name(file, disc_list.back().zip_name);
+    }
+    std::sort(disc_list.begin(), disc_list.end());
+
+    // Walk both lists together to find the added, removed and resized
+    // files and match the rest to their entry in the zip. Matches are
+    // kept in listing order so the first difference reported is the
+    // first in the listing.
+    std::vector<std::pair<const PackageFile *, const ZipEntry *> > same_size(disc_list.size(),
+    		std::pair<const PackageFile *, const ZipEntry *>(nullptr, nullptr));
+    const DiscListEntry *first_added = nullptr, *first_resized = nullptr;
+    const ZipEntry *first_removed = nullptr;
+    int num_added = 0, num_resized = 0, num_removed = 0;
+
+    std::vector<DiscListEntry>::const_iterator disc_it = disc_list.begin();
+    std::vector<ZipEntry>::const_iterator zip_it = zip_list.begin();
+    while (disc_it != disc_list.end() || zip_it != zip_list.end())
+    {
+    	if (zip_it != zip_list.end() && (&(*zip_it) == zip_control || &(*zip_it) == zip_copyright))
     	{
-    		return false;
+    		// Already checked
+    		++zip_it;
+    		continue;
+    	}
+
+    	int cmp;
+    	if (zip_it == zip_list.end()) cmp = -1;
+    	else if (disc_it == disc_list.end()) cmp = 1;
+    	else cmp = disc_it->zip_name.compare(zip_it->name);
+
+    	if (cmp < 0)
+    	{
+    		if (num_added++ == 0 || disc_it->order < first_added->order) first_added = &(*disc_it);
+    		++disc_it;
+    	} else if (cmp > 0)
+    	{
+    		if (num_removed++ == 0) first_removed = &(*zip_it);
+    		++zip_it;
+    	} else
+    	{
+    		if (disc_it->file->length != zip_it->size)
+    		{
+    			if (num_resized++ == 0 || disc_it->order < first_resized->order) first_resized = &(*disc_it);
+    		} else
+    		{
+    			same_size[disc_it->order] = std::make_pair(disc_it->file, &(*zip_it));
+    		}
+    		++disc_it;
+    		++zip_it;
     	}
     }
 
-    // zip contents should be empty now if all files in zip are in new package
-    if (!zip_contents.empty())
+    if (num_added || num_resized || num_removed)
     {
     	if (diff)
-		{
-    		*diff = tbx::to_string((int)zip_contents.size())
-    		+ " files removed, first is "
-			+ zip_contents.begin()->first;
-		}
+    	{
+    		std::string disc_name;
+    		diff->clear();
+    		if (num_added)
+    		{
+    			_tree.disc_name(*first_added->file, disc_name);
+    			*diff = tbx::to_string(num_added) + " new files, first is " + disc_name;
+    		}
+    		if (num_resized)
+    		{
+    			if (!diff->empty()) *diff += ", ";
+    			_tree.disc_name(*first_resized->file, disc_name);
+    			*diff += tbx::to_string(num_resized) + " files size changed, first is " + disc_name;
+    		}
+    		if (num_removed)
+    		{
+    			if (!diff->empty()) *diff += ", ";
+    			*diff += tbx::to_string(num_removed) + " files removed, first is " + first_removed->name;
+    		}
+    	}
     	return false;
     }
 
     // Check disc file contents against zip file
-    for (auto &disc_entry : disc_file_list)
+    std::string disc_name;
+    for (auto &match : same_size)
     {
-    	if (!file_is_same(zip_compare, disc_entry.first, disc_entry.second, diff))
+    	if (!match.first) continue;
+    	_tree.disc_name(*match.first, disc_name);
+    	if (!file_is_same(zip_reader, zip_compare, pkgfilename, disc_name, *match.second, diff))
     	{
     		return false;
     	}
@@ -1431,208 +1932,406 @@ bool Packager::same_as(const std::string &pkgfilename, std::string *diff /* = nu
    return true;
 }
 
-
 /**
- * Compare size of zip file entry to size of give text
- * @param zip_contents map of zip file contents to size
- * @param zip_filename name of file to check
- * @param text to check against
- * @param diff pointer to description of mismatch (if any)
- * @returns true if text size and zip file are the same size
+ * Compare the control record and copyright for this package with
+ * an existing package.
+ *
+ * @param pkgfilename full path to package to compare to
+ * @param diff optional string to give reason packages were different
+ * @returns true if the control record and copyright are the same
  */
-bool Packager::compare_file_text_size(std::map<std::string, int> &zip_contents, const std::string &zip_filename, const std::string &text, std::string *diff) const
+bool Packager::same_metadata_as(const std::string &pkgfilename, std::string *diff /* = nullptr */) const
 {
-	if (zip_contents[zip_filename] == (int)text.size())
+	ZipReader zip_reader;
+	if (!zip_reader.open(pkgfilename))
 	{
-		return true;
-	} else
-	{
-		if (diff) *diff = zip_filename + " size changed";
+		if (diff) *diff = pkgfilename + " does not exist";
 		return false;
 	}
+
+    std::vector<ZipEntry> zip_list;
+    sorted_zip_list(zip_reader, zip_list);
+
+    CZipArchive zip_compare;
+    bool same = same_metadata(zip_list, zip_compare, pkgfilename, diff);
+    close_zip_compare(zip_compare);
+
+    return same;
 }
 
 /**
- * Compare the contents of a file in the archive to a string
+ * Compare the control record and copyright for this package with
+ * the contents of an existing package that have already been read.
  *
- * @param zip_compare archive containing file to compare
- * @param zip_filename file name in archinve
- * @param text text to compare
- * @param diff pointer to description of mismatch (if any)
- * @return true if zip file contents and text match.
+ * @param zip_list files in the existing package sorted by name
+ * @param pkgfilename full path to the package, only opened if crc_compare is not set
+ * @param diff optional string to give reason packages were different
+ * @returns true if the control record and copyright are the same
+ */
+bool Packager::same_metadata_as(const std::vector<ZipEntry> &zip_list, const std::string &pkgfilename, std::string *diff /* = nullptr */) const
+{
+	CZipArchive zip_compare;
+	bool same = same_metadata(zip_list, zip_compare, pkgfilename, diff);
+	close_zip_compare(zip_compare);
+
+	return same;
+}
+
+/**
+ * Fingerprint of the control record
+ *
+ * @returns 64 bit FNV-1a hash of the control record text
+ */
+unsigned long long Packager::control_fingerprint() const
+{
+	return Fnv64::of(control_as_text());
+}
+
+/**
+ * Fingerprint of the copyright
+ *
+ * This is the 64 bit FNV-1a hash of the copyright text as it is written
+ * to the package, so it is the same whether or not the copyright was set
+ * with shared text.
+ *
+ * @returns copyright fingerprint
+ */
+unsigned long long Packager::copyright_fingerprint() const
+{
+	Fnv64 fnv;
+	fnv.update(_copyright);
+	if (_copyright_body) fnv.update(*_copyright_body);
+	return fnv.value();
+}
+
+/**
+ * Compare the control record and copyright with the fingerprints
+ * recorded when an existing package was created.
+ *
+ * @param digests digests of the existing package with its fingerprints
+ * @param diff optional string to give reason packages were different
+ * @returns true if the fingerprints match
  */
-bool Packager::file_text_is_same(CZipArchive &zip_compare, const std::string &zip_filename, const std::string &text, std::string *diff) const
+bool Packager::same_fingerprints(const PackageDigests &digests, std::string *diff /*= nullptr*/) const
 {
-	ZIP_INDEX_TYPE index = zip_compare.FindFile(zip_filename.c_str());
-	if (index == ZIP_FILE_INDEX_NOT_FOUND)
+	if (copyright_fingerprint() != digests.copyright_fingerprint)
 	{
-		if (diff) *diff = zip_filename + " does not exist";
+		if (diff) *diff = "RiscPkg/Copyright contents changed";
 		return false;
 	}
-	if (!zip_compare.OpenFile(index))
+	if (control_fingerprint() != digests.control_fingerprint)
 	{
-		if (diff) *diff = zip_filename + " could not be opened";
+		if (diff) *diff = "RiscPkg/Control contents changed";
 		return false;
 	}
+	return true;
+}
+
+/**
+ * Build a list of the files in a zip sorted by name
+ *
+ * @param zip_reader open zip file
+ * @param zip_list list to fill in
+ */
+void Packager::sorted_zip_list(const ZipReader &zip_reader, std::vector<ZipEntry> &zip_list)
+{
+    zip_list.reserve(zip_reader.size());
+    for (const ZipEntry &entry : zip_reader)
+    {
+    	if (!entry.directory()) zip_list.push_back(entry);
+    }
+    std::sort(zip_list.begin(), zip_list.end());
+}
+
+/**
+ * Check the control record and copyright match those in an existing package
+ *
+ * @param zip_list sorted contents of existing package
+ * @param zip_compare archive to decompress files from, opened when it is needed
+ * @param pkgfilename full path to package to compare to
+ * @param diff optional string to give reason packages were different
+ * @returns true if they are the same
+ */
+bool Packager::same_metadata(const std::vector<ZipEntry> &zip_list, CZipArchive &zip_compare, const std::string &pkgfilename, std::string *diff) const
+{
+    const ZipEntry *zip_copyright = find_zip_entry(zip_list, "RiscPkg/Copyright");
+    const ZipEntry *zip_control = find_zip_entry(zip_list, "RiscPkg/Control");
+
+    // First check control/copyright content size changes
+    if (!compare_file_text_size(zip_copyright, "RiscPkg/Copyright", _copyright, _copyright_body.get(), diff))
+    {
+    	return false;
+    }
+
+    const std::string &control = control_as_text();
+    if (!compare_file_text_size(zip_control, "RiscPkg/Control", control, nullptr, diff))
+    {
+    	return false;
+    }
+
+    // Now check control/copyright for content changes
+    if (!file_text_is_same(zip_compare, pkgfilename, *zip_copyright, _copyright, _copyright_body.get(), diff))
+    {
+    	return false;
+    }
+
+    return file_text_is_same(zip_compare, pkgfilename, *zip_control, control, nullptr, diff);
+}
+
+/**
+ * Read the files to be packaged from disc.
+ *
+ * The snapshot is kept until the items to package are changed so
+ * the files are only read once when a package is compared and saved.
+ *
+ * @param error optional string updated with reason for any failure
+ * @returns true if the files were read
+ */
+bool Packager::scan_files(std::string *error /*= nullptr*/) const
+{
+	if (_tree.built()) return true;
+	return _tree.build(_items_to_package, error);
+}
+
+/**
+ * Find an entry in the sorted list of zip contents
+ *
+ * @param zip_list sorted list of zip file contents
+ * @param zip_filename name of file to find
+ * @returns pointer to entry or nullptr if not found
+ */
+const ZipEntry *Packager::find_zip_entry(const std::vector<ZipEntry> &zip_list, const std::string &zip_filename)
+{
+	ZipEntry key;
+	key.name = zip_filename;
+	std::vector<ZipEntry>::const_iterator found = std::lower_bound(zip_list.begin(), zip_list.end(), key);
+	if (found == zip_list.end() || found->name != zip_filename) return nullptr;
+	return &(*found);
+}
 
-	std::unique_ptr<char> buf(new char[text.size() + 2]);
-	int num_read = zip_compare.ReadFile((void *)buf.get(), text.size()+2);
-	zip_compare.CloseFile();
-	if (num_read != (int)text.size())
+/**
+ * Open the existing package to extract files for comparison
+ *
+ * @param zip_compare archive to open, left as it is if already open
+ * @param pkgfilename full path of the package
+ * @param diff optional string updated if it can not be opened
+ * @returns true if the archive is open
+ */
+bool Packager::open_zip_compare(CZipArchive &zip_compare, const std::string &pkgfilename, std::string *diff)
+{
+	if (!zip_compare.IsClosed()) return true;
+	try
 	{
-		if (diff) *diff = zip_filename + " different size in zip";
-		return false;
+		if (zip_compare.Open(pkgfilename.c_str(), CZipArchive::zipOpenReadOnly)) return true;
+	} catch(CZipException &e)
+	{
+		zip_compare.Close(CZipArchive::afAfterException);
 	}
+	if (diff) *diff = pkgfilename + " could not be opened";
+	return false;
+}
 
-	if (text.compare(0, text.size(), buf.get(), text.size()) == 0)
+/**
+ * Get the index of an entry in the package opened by open_zip_compare
+ *
+ * The index read from the central directory is used when it is known.
+ * Entries from the package contents don't have it so are found by name.
+ *
+ * @param zip_compare open archive
+ * @param zip_entry entry to find
+ * @returns index of the entry or ZIP_FILE_INDEX_NOT_FOUND
+ */
+static ZIP_INDEX_TYPE zip_compare_index(CZipArchive &zip_compare, const ZipEntry &zip_entry)
+{
+	if (zip_entry.index >= 0) return (ZIP_INDEX_TYPE)zip_entry.index;
+
+	zip_compare.EnableFindFast(true);
+	return zip_compare.FindFile(zip_entry.name.c_str(), CZipArchive::ffCaseSens);
+}
+
+/**
+ * Close the package opened by open_zip_compare if it was needed
+ *
+ * @param zip_compare archive to close
+ */
+void Packager::close_zip_compare(CZipArchive &zip_compare)
+{
+	if (!zip_compare.IsClosed()) zip_compare.Close();
+}
+
+/**
+ * Compare size of zip file entry to size of give text
+ * @param zip_entry entry in zip file or nullptr if it doesn't exist
+ * @param zip_filename name of file to check
+ * @param text to check against
+ * @param more_text optional text that follows text
+ * @param diff pointer to description of mismatch (if any)
+ * @returns true if text size and zip file are the same size
+ */
+bool Packager::compare_file_text_size(const ZipEntry *zip_entry, const std::string &zip_filename, const std::string &text, const std::string *more_text, std::string *diff) const
+{
+	if (zip_entry == nullptr)
+	{
+		if (diff) *diff = zip_filename + " does not exist";
+		return false;
+	} else if (zip_entry->size == text.size() + (more_text ? more_text->size() : 0))
 	{
 		return true;
 	} else
 	{
-		char *bc = buf.get();
-		int i = 0;
-		for (char ch : text)
-		{
-			i++;
-			if (*bc != ch) std::cout << "cd " << i << " " << *bc << " != " << ch << std::endl;
-			bc++;
-		}
-		if (diff) *diff = zip_filename + " contents changed";
+		if (diff) *diff = zip_filename + " size changed";
 		return false;
 	}
 }
 
 /**
- * Build list of files to package (matched to name in zipfile)
+ * Compare the contents of a file in the archive to a string
  *
- * This routine exits before the list is build if a file is not
- * found in the zip or the file lengths do not match.
+ * The CRC from the zip central directory is checked first. Unless
+ * crc_compare is set a matching file is then extracted and compared
+ * byte for byte.
  *
- * @param disc_file_list list to update
- * @param zip_contents list of zip file contents (found files are removed)
- * @param disc_dirname name of directory on disc
- * @param zip_dirname name of directory in the zip
- * @param diff pointer to description of missing file (if any)
- * return true if full list is built
+ * @param zip_compare archive to extract the file from, opened when it is needed
+ * @param pkgfilename full path of the archive
+ * @param zip_entry entry for file in the archive
+ * @param text text to compare
+ * @param more_text optional text that follows text
+ * @param diff pointer to description of mismatch (if any)
+ * @return true if zip file contents and text match.
  */
-bool Packager::build_disc_list(
-		std::map<std::string, std::string> &disc_file_list,
-		std::map<std::string, int> &zip_contents,
-		const std::string &disc_dirname,
-		const std::string &zip_dirname,
-		std::string *diff) const
+bool Packager::file_text_is_same(CZipArchive &zip_compare, const std::string &pkgfilename, const ZipEntry &zip_entry, const std::string &text, const std::string *more_text, std::string *diff) const
 {
-	std::vector<std::string> subdirs;
-	std::string disc_filename;
-	std::string zip_filename;
-//	std::cout << "Comparing " << disc_dirname << " with " << zip_dirname << std::endl;
-	tbx::PathInfo dir(tbx::Path(disc_dirname));
-	for (tbx::PathInfo::Iterator it = tbx::PathInfo::begin(disc_dirname); it != tbx::PathInfo::end(); ++it)
+	if (zip_entry.size != text.size() + (more_text ? more_text->size() : 0))
 	{
-		if (it->directory())
-		{
-			subdirs.push_back(it->name());
-		} else
-		{
-			disc_filename = disc_dirname + "." + it->name();
-			zip_filename = zip_dirname + "/" + riscos_to_zip_name(it->name());
-			auto found_in_zip = zip_contents.find(zip_filename);
-			if (found_in_zip == zip_contents.end())
-			{
-				if (diff) *diff = "new file " + disc_filename;
-				return false;
-			} else
-			{
-				if (it->length() != found_in_zip->second)
-				{
-					if (diff) *diff = "file size changed " + disc_filename;
-					return false;
-				}
-				// Erase file from contents list we can see if any files have
-				// been deleted
-				zip_contents.erase(found_in_zip);
-				disc_file_list[disc_filename] = zip_filename;
-			}
-		}
+		if (diff) *diff = zip_entry.name + " different size in zip";
+		return false;
 	}
 
-	for(std::string &subdir : subdirs)
+	Crc32 crc;
+	crc.update(text);
+	if (more_text) crc.update(*more_text);
+	bool same = (crc.value() == zip_entry.crc);
+
+	if (same && !_crc_compare)
 	{
-		if (!build_disc_list(disc_file_list, zip_contents,
-				disc_dirname + "." + subdir,
-				zip_dirname + "/" + riscos_to_zip_name(subdir),
-				diff))
+		std::string zip_text;
+		if (!open_zip_compare(zip_compare, pkgfilename, diff)) return false;
+		ZIP_INDEX_TYPE index = zip_compare_index(zip_compare, zip_entry);
+		if (index == ZIP_FILE_INDEX_NOT_FOUND || !read_zip_item(zip_compare, index, zip_text))
 		{
+			if (diff) *diff = zip_entry.name + " could not be read";
 			return false;
 		}
+		same = (zip_text.compare(0, text.size(), text) == 0
+			&& (!more_text || zip_text.compare(text.size(), std::string::npos, *more_text) == 0));
 	}
 
-    return true;
+	if (!same && diff) *diff = zip_entry.name + " contents changed";
+
+	return same;
 }
 
 /**
  * Check if the file contents are the same as in a zip file
  *
- * @param zip_compare archive with file to compare
+ * Files stored without compression are compared directly with
+ * the data in the package file. Compressed files are decompressed
+ * and compared byte for byte unless crc_compare is set, when the
+ * CRC of the file on disc is compared with the CRC in the zip central
+ * directory instead so the file is never decompressed.
+ *
+ * @param zip_reader reader for the archive with file to compare,
+ * opened if it is needed and isn't already open
+ * @param zip_compare archive to decompress the file from, opened when it is needed
+ * @param pkgfilename full path of the archive
  * @param disc_filename name on disc
- * @param zip_filename name in zip archive
+ * @param zip_entry entry for file in zip archive
  * @param diff string update with message if file is not the same
  * @param true if file contents are the same
  */
-bool Packager::file_is_same(CZipArchive &zip_compare, const std::string &disc_filename, const std::string &zip_filename, std::string *diff) const
+bool Packager::file_is_same(ZipReader &zip_reader, CZipArchive &zip_compare, const std::string &pkgfilename, const std::string &disc_filename, const ZipEntry &zip_entry, std::string *diff) const
 {
-	const int BUFFER_SIZE = 16384;
+	const int BUFFER_SIZE = 65536;
 	static char disc_buffer[BUFFER_SIZE];
 	static char zip_buffer[BUFFER_SIZE];
 
-	ZIP_INDEX_TYPE index = zip_compare.FindFile(zip_filename.c_str());
-	if (index == ZIP_FILE_INDEX_NOT_FOUND)
-	{
-		if (diff) *diff = zip_filename + " does not exist";
-		return false;
-	}
-
-	if (!zip_compare.OpenFile(index))
-	{
-		if (diff) *diff = zip_filename + " could not be opened";
-		return false;
-	}
-
 	std::ifstream check(disc_filename, std::ios::binary);
 	if (!check)
 	{
-		zip_compare.Close();
-		if (diff) *diff = zip_filename + " could not be opened";
+		if (diff) *diff = disc_filename + " could not be opened";
 		return false;
 	}
 
-	int zip_read;
-	bool same = true;
+	if (zip_entry.method == 0)
+	{
+		if (!zip_reader.is_open() && !zip_reader.open(pkgfilename))
+		{
+			if (diff) *diff = pkgfilename + " could not be opened";
+			return false;
+		}
+		if (!zip_reader.stored_same_as(zip_entry, check))
+		{
+			if (diff) *diff = disc_filename + " contents changed";
+			return false;
+		}
+		return true;
+	}
 
-	while (check && same)
+	if (!_crc_compare)
 	{
-		check.read(disc_buffer, BUFFER_SIZE);
-		zip_read = zip_compare.ReadFile((void *)zip_buffer, BUFFER_SIZE);
-		if (zip_read != check.gcount())
+		if (!open_zip_compare(zip_compare, pkgfilename, diff)) return false;
+		ZIP_INDEX_TYPE index = zip_compare_index(zip_compare, zip_entry);
+		if (index == ZIP_FILE_INDEX_NOT_FOUND || !zip_compare.OpenFile(index))
 		{
-			same = false;
-			if (diff) *diff = disc_filename + " read bytes size mismatch";
-		} else
+			if (diff) *diff = zip_entry.name + " could not be opened";
+			return false;
+		}
+
+		bool same = true;
+		while (check && same)
 		{
-			if (std::memcmp(disc_buffer, zip_buffer, zip_read) != 0)
+			check.read(disc_buffer, BUFFER_SIZE);
+			unsigned int zip_read = zip_compare.ReadFile((void *)zip_buffer, BUFFER_SIZE);
+			if (zip_read != check.gcount())
+			{
+				same = false;
+				if (diff) *diff = disc_filename + " read bytes size mismatch";
+			} else if (std::memcmp(disc_buffer, zip_buffer, zip_read) != 0)
 			{
 				same = false;
 				if (diff) *diff = disc_filename + " contents changed";
 			}
 		}
+		if (same && zip_compare.ReadFile((void *)zip_buffer, 1) != 0)
+		{
+			same = false;
+			if (diff) *diff = disc_filename + " read bytes size mismatch";
+		}
+		zip_compare.CloseFile();
+
+		return same;
+	}
+
+	Crc32 crc;
+	unsigned int total_read = 0;
+	while (check)
+	{
+		check.read(disc_buffer, BUFFER_SIZE);
+		crc.update(disc_buffer, check.gcount());
+		total_read += check.gcount();
 	}
 
-	if (same && zip_compare.ReadFile((void *)zip_buffer, 1) != 0)
+	if (total_read != zip_entry.size)
 	{
 		if (diff) *diff = disc_filename + " read bytes size mismatch";
-		same = false;
+		return false;
 	}
-	zip_compare.CloseFile();
 
-    return same;
+	if (crc.value() != zip_entry.crc)
+	{
+		if (diff) *diff = disc_filename + " contents changed";
+		return false;
+	}
+
+    return true;
 }
@@ -23,9 +23,13 @@
 
 #include <string>
 #include <map>
+#include <unordered_map>
+#include <memory>
 #include <vector>
 #include <ostream>
 #include <istream>
+#include "PackageTree.h"
+#include "Dependency.h"
 
 enum PackageItem {
   PACKAGE_NAME,
@@ -52,6 +56,11 @@ enum PackageItem {
 class  PackagerTextEndPoint;
 
 class CZipArchive;
+class DigestZipFile;
+struct PackageDigests;
+class BlobCache;
+struct ZipEntry;
+class ZipReader;
 
 namespace tbx
 {
@@ -178,6 +187,13 @@ public:
        std::string _suggests;
        std::string _conflicts;
        std::string _copyright;
+       // Copyright text shared between packages that follows _copyright
+       std::shared_ptr<const std::string> _copyright_body;
+       // Copyright text with the shared text joined, built by copyright()
+       mutable std::string _copyright_text;
+       mutable bool _copyright_text_valid;
+       // Parsed Depends, Recommends, Suggests and Conflicts fields
+       std::vector<Dependency> _dependencies[CONFLICTS - DEPENDS + 1];
 
        bool _modified;
 
@@ -185,18 +201,66 @@ public:
        std::string _errors[NUM_ITEMS];
        static const char *_item_names[NUM_ITEMS];
 
-       // work variables for save
-       int _base_dir_size;
+       /**
+        * Description of a field in the control record
+        */
+       struct ControlField
+       {
+          const char *name;
+          size_t name_len;
+          void (Packager::*set)(std::string value);
+          std::string Packager::*value;
+          void (Packager::*parse)(std::string &value);
+          void (Packager::*write)(std::string &text) const;
+       };
+       static const ControlField _control_fields[];
+
+       // Snapshot of files on disc shared by same_as and save
+       mutable PackageTree _tree;
+       // Optional cache of compressed files
+       BlobCache *_blob_cache;
+       // Control record text built by control_as_text
+       mutable std::string _control_text;
+       mutable bool _control_text_valid;
+
+       // Validation left for validate() when lazy validation is on
+       bool _lazy_validation;
+       // Compare files with existing packages by CRC-32 and size only
+       bool _crc_compare;
+       bool _install_to_pending;
+       std::string _pending_install_to;
+       unsigned int _depends_pending;
+       // Position of each item to package by its source
+       std::unordered_map<std::string, std::vector<ItemToPackage>::size_type> _source_index;
+       bool _source_index_valid;
 
     public:
        Packager();
        ~Packager();
 
-       bool save(std::string filename, std::string *error = nullptr);
+       bool save(std::string filename, std::string *error = nullptr, PackageDigests *digests = nullptr);
+       bool promote(const std::string &from_pkgfile, std::string filename, std::string *error = nullptr, PackageDigests *digests = nullptr);
+       bool save_if_changed(std::string filename, const std::string &last_pkgfile, const std::vector<ZipEntry> *last_list,
+    		   bool &changed, std::string *diff = nullptr, std::string *error = nullptr, PackageDigests *digests = nullptr);
+       void blob_cache(BlobCache *cache) {_blob_cache = cache;}
 
        bool modified() const {return _modified;}
        void modified(bool modified);
 
+       void lazy_validation(bool lazy);
+       bool lazy_validation() const {return _lazy_validation;}
+       void validate();
+
+       /**
+        * Set if files are compared with an existing package using the
+        * CRC-32 and size from its central directory instead of their contents.
+        *
+        * This saves decompressing the existing package, but a change that
+        * keeps the size and CRC-32 the same will not be spotted.
+        */
+       void crc_compare(bool crc) {_crc_compare = crc;}
+       bool crc_compare() const {return _crc_compare;}
+
        int error_count() const {return _error_count;}
        int first_error() const {return next_error(-1);}
        int next_error(int i) const;
@@ -215,38 +279,50 @@ public:
        void maintainer (std::string value);
        void standards_version(std::string value);
 
-       std::string package_name() const  {return _package_name;}
-       std::string version() const  {return _version;}
-       std::string package_version() const  {return _package_version;}
-       std::string section() const  {return _section;}
-       std::string priority() const  {return _priority; }
-       std::string maintainer() const  {return _maintainer;}
-       std::string standards_version() const  {return _standards_version;}
+       const std::string &package_name() const  {return _package_name;}
+       const std::string &version() const  {return _version;}
+       const std::string &package_version() const  {return _package_version;}
+       const std::string &section() const  {return _section;}
+       const std::string &priority() const  {return _priority; }
+       const std::string &maintainer() const  {return _maintainer;}
+       const std::string &standards_version() const  {return _standards_version;}
 
        const std::vector<ItemToPackage> &items_to_package() const {return _items_to_package;};
-       std::vector<ItemToPackage> &items_to_package() {return _items_to_package;};
+       std::vector<ItemToPackage> &items_to_package() {_tree.clear(); _control_text_valid = false; _source_index_valid = false; return _items_to_package;};
        void set_item_to_package(const ItemToPackage &item);
        void remove_item_to_package(const std::string &source);
 
-       std::string summary() const  {return _summary; }
+       const std::string &summary() const  {return _summary; }
        void summary(std::string value);
-       std::string description() const { return _description; }
+       const std::string &description() const { return _description; }
        void description(std::string description);
 
-       std::string licence() const { return _licence;}
+       const std::string &licence() const { return _licence;}
        void licence(std::string licence);
 
-       std::string copyright() const { return _copyright;}
+       const std::string &copyright() const;
        void copyright(std::string value);
+       void copyright(std::string prefix, std::shared_ptr<const std::string> body);
+       /** Copyright text for this package that comes before any shared text */
+       const std::string &copyright_prefix() const {return _copyright;}
+       /** Copyright text shared with other packages or nullptr */
+       const std::shared_ptr<const std::string> &copyright_body() const {return _copyright_body;}
 
-       std::string depends() const {return _depends;}
+       const std::string &depends() const {return _depends;}
        void depends(std::string value);
-       std::string recommends() const {return _recommends;}
+       const std::string &recommends() const {return _recommends;}
        void recommends(std::string value);
-       std::string suggests() const {return _suggests;}
+       const std::string &suggests() const {return _suggests;}
        void suggests(std::string value);
-       std::string conflicts() const {return _conflicts;}
+       const std::string &conflicts() const {return _conflicts;}
        void conflicts(std::string value);
+       /**
+        * Get the parsed form of a dependency field
+        *
+        * @param where DEPENDS, RECOMMENDS, SUGGESTS or CONFLICTS
+        * @returns dependencies, empty if the field is empty or invalid
+        */
+       const std::vector<Dependency> &dependencies(PackageItem where) const {return _dependencies[where - DEPENDS];}
 
        void components(std::string value);
 
@@ -256,10 +332,34 @@ public:
 
        void read_control(const std::string &filename);
        void read_control(std::istream &in);
+       void read_control(const char *buffer, size_t size);
 
        std::string standard_leafname() const;
+       const std::string &control_as_text() const;
 
        bool same_as(const std::string &pkgfilename, std::string *diff = nullptr) const;
+       bool same_as(const std::vector<ZipEntry> &zip_list, const std::string &pkgfilename, std::string *diff = nullptr) const;
+       bool same_files_as(const std::vector<ZipEntry> &zip_list, const std::string &pkgfilename, std::string *diff = nullptr) const;
+
+       bool same_metadata_as(const std::string &pkgfilename, std::string *diff = nullptr) const;
+       bool same_metadata_as(const std::vector<ZipEntry> &zip_list, const std::string &pkgfilename, std::string *diff = nullptr) const;
+       bool same_digest_as(const std::string &pkgfilename, std::string *diff = nullptr) const;
+       bool same_digest(const std::string &old_digest, std::string *diff = nullptr) const;
+       bool package_digest(std::string &digest, std::string *error = nullptr) const;
+
+       unsigned long long control_fingerprint() const;
+       unsigned long long copyright_fingerprint() const;
+       bool same_fingerprints(const PackageDigests &digests, std::string *diff = nullptr) const;
+
+       bool scan_files(std::string *error = nullptr) const;
+       /**
+        * Snapshot of the files to package, only valid after scan_files
+        * or same_as have been called.
+        */
+       const PackageTree &file_tree() const {return _tree;}
+
+       static std::string zip_to_riscos_name(const std::string &zipname);
+       static std::string riscos_to_zip_name(const std::string &riscosname);
 
     private:
        void validate_install_to(std::string where);
@@ -268,35 +368,45 @@ public:
 
        bool standards_version_lt(std::string value);
 
-       void check_depends(PackageItem where, std::string depends);
-       std::string check_one_dependency(std::string dep) const;
+       void check_depends(PackageItem where, const std::string &depends);
+       void parse_depends(PackageItem where, const std::string &depends);
+       static const std::string &install_roots_text();
 
        // Load package helpers
        void set_install_item(std::string &install_item, const std::string &item_name, bool &can_grow);
        void set_payload(const std::string &name);
-       std::string zip_to_riscos_name(const std::string &zipname) const;
-       std::string riscos_to_zip_name(const std::string &riscosname) const;
 
-       bool read_zip_item(CZipArchive &zip, int index, std::string &data);
+       static bool read_zip_item(CZipArchive &zip, int index, std::string &data);
 
-       void set_control_field(std::string name, std::string value);
+       void set_control_field(const char *name, size_t name_len, std::string &value);
+       void parse_version_field(std::string &value);
+       void parse_description_field(std::string &value);
+       void write_version_field(std::string &text) const;
+       void write_description_field(std::string &text) const;
+       void write_components_field(std::string &text) const;
        // Save package helpers
-       void write_control(CZipArchive &zip) const;
-       void write_copyright(CZipArchive &zip) const;
+       // Value for copy_count to take every file from the package copied from
+       static const std::size_t COPY_ALL_FILES = (std::size_t)-1;
+       bool write_package(const std::string &filename, const std::string *copy_from, std::size_t copy_count, std::string *error, PackageDigests *digests) const;
+       bool create_package(const std::string &filename, DigestZipFile *digest_file, const std::string *copy_from, std::size_t copy_count, std::string *error) const;
+       static std::time_t package_time();
+       void write_control(CZipArchive &zip, std::time_t modified) const;
+       void write_copyright(CZipArchive &zip, std::time_t modified) const;
 
        // Zip file creation helpers
-       void write_text_file(CZipArchive &zip, const char *filename, std::string text) const;
-       void get_file_list(const tbx::Path &dirname, std::vector<std::pair<tbx::Path, tbx::PathInfo> > &file_list) const;
-       void copy_files(CZipArchive &zip, const tbx::Path &dirname, const std::string &install_to) const;
-       void copy_file(CZipArchive &zip, const tbx::Path &filename, const std::string &install_to) const;
-       void copy_file(CZipArchive &zip, const tbx::Path &filename, tbx::PathInfo &entry, const std::string &install_to) const;
+       void write_text_file(CZipArchive &zip, const char *filename, const std::string &text, const std::string *more_text, std::time_t modified) const;
+       void copy_file(CZipArchive &zip, const PackageFile &file, const std::string &disc_name, const std::string &zip_name, std::time_t undated_time) const;
 
        // Package with existing package comparison helpers
-       std::string control_as_text() const;
-       bool compare_file_text_size(std::map<std::string, int> &zip_contents, const std::string &zip_filename, const std::string &text, std::string *diff) const;
-       bool file_text_is_same(CZipArchive &zip_compare, const std::string &zip_filename, const std::string &text, std::string *diff) const;
-       bool build_disc_list(std::map<std::string, std::string> &disc_file_list, std::map<std::string, int> &zip_contents, const std::string &disc_dirname, const std::string &zip_dirname, std::string *diff) const;
-       bool file_is_same(CZipArchive &zip_compare, const std::string &disc_filename, const std::string &zip_filename, std::string *diff) const;
+       static void sorted_zip_list(const ZipReader &zip_reader, std::vector<ZipEntry> &zip_list);
+       bool same_metadata(const std::vector<ZipEntry> &zip_list, CZipArchive &zip_compare, const std::string &pkgfilename, std::string *diff) const;
+       bool same_contents(const std::vector<ZipEntry> &zip_list, ZipReader &zip_reader, CZipArchive &zip_compare, const std::string &pkgfilename, std::string *diff) const;
+       static bool open_zip_compare(CZipArchive &zip_compare, const std::string &pkgfilename, std::string *diff);
+       static void close_zip_compare(CZipArchive &zip_compare);
+       static const ZipEntry *find_zip_entry(const std::vector<ZipEntry> &zip_list, const std::string &zip_filename);
+       bool compare_file_text_size(const ZipEntry *zip_entry, const std::string &zip_filename, const std::string &text, const std::string *more_text, std::string *diff) const;
+       bool file_text_is_same(CZipArchive &zip_compare, const std::string &pkgfilename, const ZipEntry &zip_entry, const std::string &text, const std::string *more_text, std::string *diff) const;
+       bool file_is_same(ZipReader &zip_reader, CZipArchive &zip_compare, const std::string &pkgfilename, const std::string &disc_filename, const ZipEntry &zip_entry, std::string *diff) const;
 
 };
 
@@ -57,6 +57,34 @@ RISCOSZipExtra::RISCOSZipExtra(int file_type)
    reserved = 0;
 }
 
+/**
+ * Construct for a file of the given type with a fixed date stamp
+ *
+ * @param file_type RISC OS file type
+ * @param modified modification time
+ */
+RISCOSZipExtra::RISCOSZipExtra(int file_type, std::time_t modified)
+{
+  signature = 0x30435241;
+
+  // RISC OS time is centiseconds since 1900
+  long long csecs = modified;
+  csecs += 25567LL * 24 * 60 * 60;
+  csecs *= 100;
+
+  execaddress = (unsigned int)csecs;
+  loadaddress = 0xFFF00000; // Marks as file type
+  loadaddress |= file_type << 8; // File type
+  loadaddress |= (unsigned int)(csecs >> 32) & 0xFF;
+
+  attributes = 1 /*ATTR_OWNER_READ */
+               | 2 /* OWNER_WRITE */
+               | 0X10 /* WORLD_READ */
+               | 0x20 /* WORLD_WRITE */;
+
+  reserved = 0;
+}
+
 RISCOSZipExtra::RISCOSZipExtra(const tbx::PathInfo &entry)
 {
   signature = 0x30435241;
@@ -78,6 +106,21 @@ RISCOSZipExtra::RISCOSZipExtra(const tbx::PathInfo &entry)
   }
 }
 
+/**
+ * Construct from the raw catalogue information of a file.
+ *
+ * The file type (if any) is already in the top of the load address
+ */
+RISCOSZipExtra::RISCOSZipExtra(unsigned int load, unsigned int exec, unsigned int attr)
+{
+  signature = 0x30435241;
+
+  loadaddress = load;
+  execaddress = exec;
+  attributes = attr;
+  reserved = 0;
+}
+
 
 RISCOSZipExtra::RISCOSZipExtra(void *buffer)
 {
@@ -22,6 +22,8 @@
 #ifndef RISCOSZIPEXTRA_H_
 #define RISCOSZIPEXTRA_H_
 
+#include <ctime>
+
 namespace tbx
 {
 	class PathInfo;
@@ -32,7 +34,9 @@ class RISCOSZipExtra
 public:
 	RISCOSZipExtra();
 	RISCOSZipExtra(int file_type);
+	RISCOSZipExtra(int file_type, std::time_t modified);
 	RISCOSZipExtra(const tbx::PathInfo &entry);
+	RISCOSZipExtra(unsigned int load, unsigned int exec, unsigned int attr);
 	RISCOSZipExtra(void *buffer);
 
 	void *buffer() {return &signature;}
@@ -0,0 +1,197 @@
+/*
+ * Sha256.cc
+ *
+ */
+/*********************************************************************
+* Copyright 2018 Alan Buckley
+*
+* This file is part of japkg.
+*
+* japkg is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* japkg is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with PackIt. If not, see <http://www.gnu.org/licenses/>.
+*
+*****************************************************************************/
+
+#include "Sha256.h"
+#include <fstream>
+#include <cstring>
+
+static const unsigned int k[64] =
+{
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline unsigned int rotr(unsigned int x, int n)
+{
+	return (x >> n) | (x << (32 - n));
+}
+
+Sha256::Sha256() :
+	_length(0),
+	_used(0)
+{
+	_state[0] = 0x6a09e667;
+	_state[1] = 0xbb67ae85;
+	_state[2] = 0x3c6ef372;
+	_state[3] = 0xa54ff53a;
+	_state[4] = 0x510e527f;
+	_state[5] = 0x9b05688c;
+	_state[6] = 0x1f83d9ab;
+	_state[7] = 0x5be0cd19;
+}
+
+/**
+ * Add data to the digest
+ *
+ * @param data data to add
+ * @param size size of data in bytes
+ */
+void Sha256::update(const void *data, size_t size)
+{
+	const unsigned char *p = (const unsigned char *)data;
+	_length += size;
+
+	if (_used)
+	{
+		size_t fill = 64 - _used;
+		if (fill > size) fill = size;
+		std::memcpy(_block + _used, p, fill);
+		_used += fill;
+		p += fill;
+		size -= fill;
+		if (_used < 64) return;
+		transform(_block);
+		_used = 0;
+	}
+
+	while (size >= 64)
+	{
+		transform(p);
+		p += 64;
+		size -= 64;
+	}
+
+	if (size)
+	{
+		std::memcpy(_block, p, size);
+		_used = size;
+	}
+}
+
+/**
+ * Finish the digest and return it as lower case hexadecimal.
+ *
+ * No more data can be added after this has been called.
+ */
+std::string Sha256::hex_digest()
+{
+	unsigned long long bits = _length * 8;
+	unsigned char pad[72];
+	size_t pad_len = (_used < 56) ? (56 - _used) : (120 - _used);
+	std::memset(pad, 0, sizeof(pad));
+	pad[0] = 0x80;
+	for (int i = 0; i < 8; i++)
+	{
+		pad[pad_len + i] = (unsigned char)(bits >> (56 - i * 8));
+	}
+	update(pad, pad_len + 8);
+
+	static const char *hex = "0123456789abcdef";
+	std::string digest;
+	digest.reserve(64);
+	for (int i = 0; i < 8; i++)
+	{
+		for (int shift = 28; shift >= 0; shift -= 4)
+		{
+			digest += hex[(_state[i] >> shift) & 0xF];
+		}
+	}
+	return digest;
+}
+
+/**
+ * Process one 64 byte block
+ */
+void Sha256::transform(const unsigned char *block)
+{
+	unsigned int w[64];
+	for (int i = 0; i < 16; i++)
+	{
+		w[i] = ((unsigned int)block[i*4] << 24)
+			| ((unsigned int)block[i*4+1] << 16)
+			| ((unsigned int)block[i*4+2] << 8)
+			| block[i*4+3];
+	}
+	for (int i = 16; i < 64; i++)
+	{
+		unsigned int s0 = rotr(w[i-15], 7) ^ rotr(w[i-15], 18) ^ (w[i-15] >> 3);
+		unsigned int s1 = rotr(w[i-2], 17) ^ rotr(w[i-2], 19) ^ (w[i-2] >> 10);
+		w[i] = w[i-16] + s0 + w[i-7] + s1;
+	}
+
+	unsigned int a = _state[0], b = _state[1], c = _state[2], d = _state[3];
+	unsigned int e = _state[4], f = _state[5], g = _state[6], h = _state[7];
+
+	for (int i = 0; i < 64; i++)
+	{
+		unsigned int s1 = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+		unsigned int ch = (e & f) ^ (~e & g);
+		unsigned int t1 = h + s1 + ch + k[i] + w[i];
+		unsigned int s0 = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+		unsigned int maj = (a & b) ^ (a & c) ^ (b & c);
+		unsigned int t2 = s0 + maj;
+		h = g;
+		g = f;
+		f = e;
+		e = d + t1;
+		d = c;
+		c = b;
+		b = a;
+		a = t1 + t2;
+	}
+
+	_state[0] += a; _state[1] += b; _state[2] += c; _state[3] += d;
+	_state[4] += e; _state[5] += f; _state[6] += g; _state[7] += h;
+}
+
+/**
+ * Calculate the digest of a file
+ *
+ * @param filename name of file
+ * @param hex_digest updated with digest in hexadecimal
+ * @returns true if the file could be read
+ */
+bool Sha256::of_file(const std::string &filename, std::string &hex_digest)
+{
+	std::ifstream in(filename.c_str(), std::ios::binary);
+	if (!in) return false;
+
+	Sha256 sha;
+	char buffer[16384];
+	while (in)
+	{
+		in.read(buffer, sizeof(buffer));
+		if (in.gcount()) sha.update(buffer, in.gcount());
+	}
+	if (in.bad()) return false;
+
+	hex_digest = sha.hex_digest();
+	return true;
+}
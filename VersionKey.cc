@@ -0,0 +1,192 @@
+/*
+ * VersionKey.cc
+ *
+ */
+/*********************************************************************
+* Copyright 2018 Alan Buckley
+*
+* This file is part of japkg.
+*
+* japkg is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* japkg is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with PackIt. If not, see <http://www.gnu.org/licenses/>.
+*
+*****************************************************************************/
+
+#include "VersionKey.h"
+#include <cctype>
+#include <cstring>
+
+/** Most digits always held in an unsigned long */
+static const unsigned int MAX_NUMBER_DIGITS = 9;
+
+std::map<std::string, VersionKey> VersionKey::_interned;
+
+/**
+ * Construct the key for a version string
+ *
+ * @param text version string
+ * @throws pkg::version::parse_error if the version contains illegal characters
+ */
+VersionKey::VersionKey(const std::string &text) :
+	_text(text),
+	_upstream(0),
+	_package(0)
+{
+	pkg::version version(text);
+
+	// Epoch is a single numeric segment
+	std::string epoch("0");
+	if (!version.epoch().empty()) epoch = version.epoch();
+	add_segments(epoch);
+	_upstream = _segments.size();
+	add_segments(version.upstream_version());
+	_package = _segments.size();
+	add_segments(version.package_version());
+}
+
+/**
+ * Get the shared key for a version string, creating it the first
+ * time the version is seen.
+ *
+ * @param text version string
+ * @throws pkg::version::parse_error if the version contains illegal characters
+ */
+const VersionKey &VersionKey::intern(const std::string &text)
+{
+	auto found = _interned.find(text);
+	if (found == _interned.end())
+	{
+		found = _interned.insert(std::make_pair(text, VersionKey(text))).first;
+	}
+	return found->second;
+}
+
+/**
+ * Split a version string into alternating non-numeric and numeric segments
+ */
+void VersionKey::add_segments(const std::string &verstr)
+{
+	std::string::const_iterator p = verstr.begin();
+	while (p != verstr.end())
+	{
+		Segment seg;
+		std::string::const_iterator start = p;
+		while (p != verstr.end() && !isdigit(*p)) ++p;
+		seg.lex_offset = _chars.size();
+		seg.lex_length = p - start;
+		_chars.append(start, p);
+
+		while (p != verstr.end() && *p == '0') ++p;
+		start = p;
+		while (p != verstr.end() && isdigit(*p)) ++p;
+		seg.digits_length = p - start;
+		seg.big = (seg.digits_length > MAX_NUMBER_DIGITS);
+		seg.number = 0;
+		if (seg.big)
+		{
+			seg.digits_offset = _chars.size();
+			_chars.append(start, p);
+		} else
+		{
+			seg.digits_offset = 0;
+			for (std::string::const_iterator d = start; d != p; ++d)
+			{
+				seg.number = seg.number * 10 + (*d - '0');
+			}
+		}
+		_segments.push_back(seg);
+	}
+}
+
+/**
+ * Compare with another version key
+ *
+ * @returns 0 if the versions are equal, +1 if this is greater or -1 if this is less
+ */
+int VersionKey::compare(const VersionKey &other) const
+{
+	if (this == &other) return 0;
+	if (int cmp = compare_segments(0, _upstream, other, 0, other._upstream)) return cmp;
+	if (int cmp = compare_segments(_upstream, _package, other, other._upstream, other._package)) return cmp;
+	return compare_segments(_package, _segments.size(), other, other._package, other._segments.size());
+}
+
+/**
+ * Compare a range of segments with a range of segments from another key.
+ * The shorter range is treated as if it was padded with empty segments.
+ */
+int VersionKey::compare_segments(unsigned int first, unsigned int last, const VersionKey &other, unsigned int other_first, unsigned int other_last) const
+{
+	static const Segment empty = {0, 0, 0, 0, 0, false};
+
+	while (first != last || other_first != other_last)
+	{
+		const Segment *lhs = (first != last) ? &_segments[first++] : &empty;
+		const Segment *rhs = (other_first != other_last) ? &other._segments[other_first++] : &empty;
+		if (int cmp = compare_lex(lhs, other, rhs)) return cmp;
+		if (int cmp = compare_num(lhs, other, rhs)) return cmp;
+	}
+	return 0;
+}
+
+/**
+ * Compare the non-numeric part of two segments.
+ *
+ * The order is the same as pkg::version, a tilde first, then the end
+ * of the segment, then letters and then other characters.
+ */
+int VersionKey::compare_lex(const Segment *lhs, const VersionKey &other, const Segment *rhs) const
+{
+	const char *lp = _chars.data() + lhs->lex_offset;
+	const char *llast = lp + lhs->lex_length;
+	const char *rp = other._chars.data() + rhs->lex_offset;
+	const char *rlast = rp + rhs->lex_length;
+
+	while (lp != llast && rp != rlast && *lp == *rp)
+	{
+		++lp;
+		++rp;
+	}
+
+	char lc = (lp != llast) ? *lp : 0;
+	char rc = (rp != rlast) ? *rp : 0;
+
+	if (lc == rc) return 0;
+	if (lc == '~') return -1;
+	if (rc == '~') return +1;
+	if (lc == 0) return -1;
+	if (rc == 0) return +1;
+	bool lalpha = isalpha(lc);
+	bool ralpha = isalpha(rc);
+	if (lalpha != ralpha) return lalpha ? -1 : +1;
+	return (lc < rc) ? -1 : +1;
+}
+
+/**
+ * Compare the numeric part of two segments
+ */
+int VersionKey::compare_num(const Segment *lhs, const VersionKey &other, const Segment *rhs) const
+{
+	if (lhs->digits_length != rhs->digits_length)
+	{
+		return (lhs->digits_length < rhs->digits_length) ? -1 : +1;
+	}
+	if (!lhs->big)
+	{
+		if (lhs->number == rhs->number) return 0;
+		return (lhs->number < rhs->number) ? -1 : +1;
+	}
+	int cmp = std::memcmp(_chars.data() + lhs->digits_offset, other._chars.data() + rhs->digits_offset, lhs->digits_length);
+	if (cmp == 0) return 0;
+	return (cmp < 0) ? -1 : +1;
+}
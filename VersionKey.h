@@ -0,0 +1,102 @@
+/*
+ * VersionKey.h
+ *
+ */
+/*********************************************************************
+* Copyright 2018 Alan Buckley
+*
+* This file is part of japkg.
+*
+* japkg is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* japkg is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with PackIt. If not, see <http://www.gnu.org/licenses/>.
+*
+*****************************************************************************/
+
+#ifndef VERSIONKEY_H_
+#define VERSIONKEY_H_
+
+#include <string>
+#include <vector>
+#include <map>
+#include "version.h"
+
+/**
+ * Package version split into the segments used for comparisons.
+ *
+ * The epoch, upstream version and package version are split once
+ * into alternating non-numeric and numeric segments with numbers
+ * held as integers when they fit, so comparing two keys does not
+ * need to scan or allocate. The ordering is the same as pkg::version.
+ *
+ * intern returns a shared key for each different version string so
+ * a version seen many times is only split once.
+ */
+class VersionKey
+{
+public:
+	VersionKey(const std::string &text);
+
+	/** Version text the key was created from */
+	const std::string &text() const {return _text;}
+
+	int compare(const VersionKey &other) const;
+
+	static const VersionKey &intern(const std::string &text);
+
+private:
+	/**
+	 * A non-numeric segment followed by a numeric segment
+	 */
+	struct Segment
+	{
+		/** Offset of non-numeric characters in _chars */
+		unsigned short lex_offset;
+		/** Number of non-numeric characters */
+		unsigned short lex_length;
+		/** Offset of digits after leading zeros in _chars if big */
+		unsigned short digits_offset;
+		/** Number of digits after leading zeros */
+		unsigned short digits_length;
+		/** Value of number, only used if it isn't big */
+		unsigned long number;
+		/** true if the number has too many digits for number */
+		bool big;
+	};
+
+	void add_segments(const std::string &verstr);
+	int compare_segments(unsigned int first, unsigned int last, const VersionKey &other, unsigned int other_first, unsigned int other_last) const;
+	int compare_lex(const Segment *lhs, const VersionKey &other, const Segment *rhs) const;
+	int compare_num(const Segment *lhs, const VersionKey &other, const Segment *rhs) const;
+
+private:
+	std::string _text;
+	/** Characters of non-numeric segments and big numbers */
+	std::string _chars;
+	/** Epoch followed by upstream then package version segments */
+	std::vector<Segment> _segments;
+	/** Index of first upstream version segment */
+	unsigned int _upstream;
+	/** Index of first package version segment */
+	unsigned int _package;
+
+	static std::map<std::string, VersionKey> _interned;
+};
+
+inline bool operator==(const VersionKey &lhs, const VersionKey &rhs) {return &lhs == &rhs || lhs.compare(rhs) == 0;}
+inline bool operator!=(const VersionKey &lhs, const VersionKey &rhs) {return !(lhs == rhs);}
+inline bool operator<(const VersionKey &lhs, const VersionKey &rhs) {return lhs.compare(rhs) < 0;}
+inline bool operator<=(const VersionKey &lhs, const VersionKey &rhs) {return lhs.compare(rhs) <= 0;}
+inline bool operator>(const VersionKey &lhs, const VersionKey &rhs) {return lhs.compare(rhs) > 0;}
+inline bool operator>=(const VersionKey &lhs, const VersionKey &rhs) {return lhs.compare(rhs) >= 0;}
+
+#endif /* VERSIONKEY_H_ */
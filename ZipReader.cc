@@ -0,0 +1,196 @@
+/*
+ * ZipReader.cc
+ *
+ */
+/*********************************************************************
+* Copyright 2018 Alan Buckley
+*
+* This file is part of japkg.
+*
+* japkg is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* japkg is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with PackIt. If not, see <http://www.gnu.org/licenses/>.
+*
+*****************************************************************************/
+
+#include "ZipReader.h"
+#include <cstring>
+#include <memory>
+
+// Zip record signatures and sizes
+const unsigned int EOCD_SIGNATURE = 0x06054b50;
+const unsigned int EOCD_SIZE = 22;
+const unsigned int CENTRAL_SIGNATURE = 0x02014b50;
+const unsigned int CENTRAL_SIZE = 46;
+const unsigned int LOCAL_SIGNATURE = 0x04034b50;
+const unsigned int LOCAL_SIZE = 30;
+const unsigned int MAX_COMMENT = 65535;
+
+/** Buffers for stored file compare */
+static const int COMPARE_BUFFER_SIZE = 64 * 1024;
+static char disc_buffer[COMPARE_BUFFER_SIZE];
+static char zip_buffer[COMPARE_BUFFER_SIZE];
+
+ZipReader::ZipReader() :
+	_file_size(0)
+{
+}
+
+ZipReader::~ZipReader()
+{
+}
+
+/**
+ * Open a zip file and read its central directory
+ *
+ * @param filename name of zip file
+ * @returns true if the file was opened and is a valid zip file
+ */
+bool ZipReader::open(const std::string &filename)
+{
+	close();
+	_file.open(filename.c_str(), std::ios::binary);
+	if (!_file) return false;
+
+	if (!read_central_directory())
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Close the zip file
+ */
+void ZipReader::close()
+{
+	if (_file.is_open()) _file.close();
+	_file.clear();
+	_entries.clear();
+	_file_size = 0;
+}
+
+/**
+ * Find the end of central directory record and read all the
+ * central directory entries.
+ *
+ * Zip64 archives are not supported.
+ */
+bool ZipReader::read_central_directory()
+{
+	_file.seekg(0, std::ios::end);
+	_file_size = (unsigned int)_file.tellg();
+	if (_file_size < EOCD_SIZE) return false;
+
+	// End of central directory is at the end, followed by an optional comment
+	unsigned int tail_size = EOCD_SIZE + MAX_COMMENT;
+	if (tail_size > _file_size) tail_size = _file_size;
+	std::unique_ptr<unsigned char[]> tail(new unsigned char[tail_size]);
+	_file.seekg(_file_size - tail_size);
+	if (!_file.read((char *)tail.get(), tail_size)) return false;
+
+	const unsigned char *eocd = nullptr;
+	for (unsigned int pos = tail_size - EOCD_SIZE + 1; pos-- > 0 && eocd == nullptr;)
+	{
+		if (read32(tail.get() + pos) == EOCD_SIGNATURE) eocd = tail.get() + pos;
+	}
+	if (eocd == nullptr) return false;
+
+	unsigned int num_entries = read16(eocd + 10);
+	unsigned int cd_size = read32(eocd + 12);
+	unsigned int cd_offset = read32(eocd + 16);
+	// Written so a damaged size or offset can't overflow the check
+	if (cd_size > _file_size || cd_offset > _file_size - cd_size) return false;
+
+	std::unique_ptr<unsigned char[]> cd(new unsigned char[cd_size]);
+	_file.seekg(cd_offset);
+	if (!_file.read((char *)cd.get(), cd_size)) return false;
+
+	_entries.reserve(num_entries);
+	const unsigned char *p = cd.get();
+	const unsigned char *cd_end = p + cd_size;
+	for (unsigned int i = 0; i < num_entries; i++)
+	{
+		if ((unsigned int)(cd_end - p) < CENTRAL_SIZE || read32(p) != CENTRAL_SIGNATURE) return false;
+		unsigned int name_len = read16(p + 28);
+		unsigned int extra_len = read16(p + 30);
+		unsigned int comment_len = read16(p + 32);
+		if ((unsigned int)(cd_end - p) < CENTRAL_SIZE + name_len + extra_len + comment_len) return false;
+
+		_entries.push_back(ZipEntry());
+		ZipEntry &entry = _entries.back();
+		entry.method = read16(p + 10);
+		entry.dos_time = read32(p + 12);
+		entry.crc = read32(p + 16);
+		entry.compressed_size = read32(p + 20);
+		entry.size = read32(p + 24);
+		entry.local_offset = read32(p + 42);
+		entry.name.assign((const char *)p + CENTRAL_SIZE, name_len);
+		entry.extra.assign((const char *)p + CENTRAL_SIZE + name_len, extra_len);
+		entry.index = i;
+
+		p += CENTRAL_SIZE + name_len + extra_len + comment_len;
+	}
+
+	return true;
+}
+
+/**
+ * Get the offset of the data for an entry in the zip file
+ *
+ * @param entry entry from this zip file
+ * @param offset updated to the offset of the data
+ * @returns true if the local header was valid
+ */
+bool ZipReader::data_offset(const ZipEntry &entry, unsigned int &offset)
+{
+	unsigned char local[LOCAL_SIZE];
+	_file.clear();
+	_file.seekg(entry.local_offset);
+	if (!_file.read((char *)local, LOCAL_SIZE)) return false;
+	if (read32(local) != LOCAL_SIGNATURE) return false;
+
+	unsigned int header_size = LOCAL_SIZE + read16(local + 26) + read16(local + 28);
+	if (entry.local_offset > _file_size || header_size > _file_size - entry.local_offset) return false;
+	offset = entry.local_offset + header_size;
+	return (entry.compressed_size <= _file_size - offset);
+}
+
+/**
+ * Compare the data of an entry stored without compression
+ * with a stream.
+ *
+ * @param entry stored entry from this zip file
+ * @param in stream to compare with
+ * @returns true if the stream contains exactly the same data
+ */
+bool ZipReader::stored_same_as(const ZipEntry &entry, std::istream &in)
+{
+	unsigned int offset;
+	if (entry.method != 0 || !data_offset(entry, offset)) return false;
+
+	_file.seekg(offset);
+	unsigned int left = entry.size;
+	while (left > 0)
+	{
+		unsigned int chunk = (left > (unsigned int)COMPARE_BUFFER_SIZE) ? COMPARE_BUFFER_SIZE : left;
+		if (!_file.read(zip_buffer, chunk)) return false;
+		if (!in.read(disc_buffer, chunk)) return false;
+		if (std::memcmp(disc_buffer, zip_buffer, chunk) != 0) return false;
+		left -= chunk;
+	}
+
+	// Disc file must end here as well
+	return (in.peek() == std::char_traits<char>::eof());
+}
@@ -0,0 +1,97 @@
+/*
+ * ZipReader.h
+ *
+ */
+/*********************************************************************
+* Copyright 2018 Alan Buckley
+*
+* This file is part of japkg.
+*
+* japkg is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* japkg is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with PackIt. If not, see <http://www.gnu.org/licenses/>.
+*
+*****************************************************************************/
+
+#ifndef ZIPREADER_H_
+#define ZIPREADER_H_
+
+#include <string>
+#include <vector>
+#include <fstream>
+
+/**
+ * Details of a file from the central directory of a zip file
+ */
+struct ZipEntry
+{
+	/** Name of the file in the zip */
+	std::string name;
+	/** Compression method (0 = stored, 8 = deflated) */
+	unsigned short method;
+	/** MS-DOS time (low 16 bits) and date (high 16 bits) */
+	unsigned int dos_time;
+	unsigned int crc;
+	unsigned int compressed_size;
+	unsigned int size;
+	/** Offset of the local header in the zip file */
+	unsigned int local_offset;
+	/** Extra data from the central directory */
+	std::string extra;
+	/** Index of the entry in the central directory, -1 if not known */
+	int index;
+
+	bool directory() const {return !name.empty() && name[name.size()-1] == '/';}
+
+	bool operator<(const ZipEntry &other) const {return name < other.name;}
+};
+
+/**
+ * Class to read a zip file's central directory and the data of
+ * entries directly from the file.
+ *
+ * The end of central directory record and the central directory
+ * are read with one read each so an archive can be listed without
+ * any per entry reads.
+ */
+class ZipReader
+{
+public:
+	ZipReader();
+	~ZipReader();
+
+	bool open(const std::string &filename);
+	void close();
+	bool is_open() const {return _file.is_open();}
+
+	typedef std::vector<ZipEntry>::const_iterator const_iterator;
+	const_iterator begin() const {return _entries.cbegin();}
+	const_iterator end() const {return _entries.cend();}
+	size_t size() const {return _entries.size();}
+	const ZipEntry &operator[](int index) const {return _entries[index];}
+
+	bool data_offset(const ZipEntry &entry, unsigned int &offset);
+	bool stored_same_as(const ZipEntry &entry, std::istream &in);
+
+private:
+	bool read_central_directory();
+
+	static unsigned int read16(const unsigned char *p) {return p[0] | (p[1] << 8);}
+	static unsigned int read32(const unsigned char *p) {return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);}
+
+private:
+	std::ifstream _file;
+	unsigned int _file_size;
+	std::vector<ZipEntry> _entries;
+};
+
+#endif /* ZIPREADER_H_ */
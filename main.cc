@@ -25,14 +25,26 @@
 *****************************************************************************/
 
 #include <iostream>
+#include <cstdio>
+#include <algorithm>
 #include <string>
 #include <fstream>
 #include <map>
 #include <set>
+#include <memory>
 #include "Catalogue.h"
 #include "Packager.h"
 #include "version.h"
+#include "VersionKey.h"
 #include "Log.h"
+#include "DirScan.h"
+#include "PackageManifest.h"
+#include "PackageIndex.h"
+#include "PackageContents.h"
+#include "PackageDelta.h"
+#include "BlobCache.h"
+#include "DependencyGraph.h"
+#include "PackageVersions.h"
 #include <tbx/path.h>
 #include <tbx/stringutils.h>
 #include <unixlib/local.h>
@@ -48,6 +60,13 @@ std::string s_release_packages = "release";
 std::string s_beta_packages = "beta";
 std::string s_maintainer = "Jonathan Abbott<jon@jaspp.org.uk>";
 std::string s_base_install("Apps.Games");
+std::string s_speculative_leafname("Speculative");
+std::string s_manifest_leafname("Manifest");
+std::string s_contents_leafname("Contents");
+std::string s_index_dirname("Index");
+std::string s_delta_dirname("Delta");
+std::string s_cache_dirname("Cache");
+std::string s_index_store_leafname("Store");
 /** List of characters that should not be in the package name */
 const char *s_pkgname_invalid_chars = " :'<>*?";
 
@@ -55,8 +74,8 @@ const char *s_pkgname_invalid_chars = " :'<>*?";
 const char HARD_SPACE = '\xA0';
 
 // Work variables
-/** Standard copyright text for games */
-std::string s_standard_copyright;
+/** Standard copyright text for games, shared by all the game packages */
+std::shared_ptr<const std::string> s_standard_copyright;
 /** Map of currently packages to their version */
 std::map<std::string, std::string> s_current_packages;
 /** Lookup from catalogue ID to game directory */
@@ -65,17 +84,55 @@ std::map<std::string, std::string> s_dir_lookup;
 std::set<std::string> s_used_pkgnames;
 /** Check to ensure default install directories do not clash */
 std::set<std::string> s_used_components;
+/** Sizes and digests of the packages created */
+PackageManifest s_manifest;
+/** Control records for the package index */
+PackageIndex s_index;
+/** Contents of the existing packages */
+PackageContents s_contents;
+/** Dependencies between all the packages */
+DependencyGraph s_dependencies;
+/** All the versions of the packages in the package directories */
+PackageVersions s_versions;
 
 /** Logging */
 Log s_log;
 
+// Options
+/** Build upgrades before checking if the files have changed */
+bool s_speculative = false;
+/** Compare packages by building them in memory and checking their digests */
+bool s_compare_digest = false;
+/** Compare files with the last package by size and CRC-32 only */
+bool s_crc_compare = false;
+/** Base URL for the packages in the index, index isn't written if it is empty */
+std::string s_index_url;
+/** Create deltas from the previous version of upgraded packages */
+bool s_create_delta = false;
+/** Maximum size of compressed file cache in megabytes, 0 for no cache */
+unsigned int s_cache_size = 0;
+/** Cache of compressed files */
+BlobCache s_blob_cache;
+/** Number of versions of each package to keep, 0 to keep them all */
+unsigned int s_keep_versions = 0;
+
 // Functions in this file
 static void package_extras();
 static void package_extra(const std::string &extra_dir);
 static void package_game(const CatEntry &entry);
 static void check_and_save_package(Packager &pkg, Log::PackageContext &log_context, bool released);
-static void current_package_list(const std::string &from_dirname);
+static void speculative_save(Packager &pkg, Log::PackageContext &log_context, bool released, const std::string &lastpkgfile);
+static void create_delta(const std::string &previous_pkgfile, const std::string &pkgfile, const std::string &type, Log::PackageContext &log_context);
+static bool current_package_list();
+static void prune_packages();
 static void create_dir_lookup();
+static void update_package_dir(const std::string &type);
+static void record_fingerprints(const std::string &name, const Packager &pkg);
+static void index_package(const std::string &pkgfile, const Packager &pkg);
+static void add_dependencies(const Packager &pkg);
+static void check_dependencies();
+static void update_index(const std::string &type);
+static void write_index(const std::string &type);
 static bool validate_pkgname(const std::string &pkgname, std::string *errmsg = nullptr);
 static bool calc_version(const std::string &pkg_dir, std::string &version);
 
@@ -94,12 +151,49 @@ int main(int argc, char *argv[0])
 		app_dir = ropath;
 		app_dir.erase(app_dir.rfind('.'));
 	}
+
+	for (int arg = 1; arg < argc; arg++)
+	{
+		std::string option(argv[arg]);
+		if (option == "-speculative")
+		{
+			s_speculative = true;
+		} else if (option == "-digest")
+		{
+			s_compare_digest = true;
+		} else if (option == "-crc")
+		{
+			s_crc_compare = true;
+		} else if (option == "-cache" && arg + 1 < argc)
+		{
+			s_cache_size = tbx::from_string<unsigned int>(argv[++arg]);
+		} else if (option == "-keep" && arg + 1 < argc)
+		{
+			s_keep_versions = tbx::from_string<unsigned int>(argv[++arg]);
+		} else if (option == "-delta")
+		{
+			s_create_delta = true;
+		} else if (option == "-index" && arg + 1 < argc)
+		{
+			s_index_url = argv[++arg];
+			if (!s_index_url.empty() && s_index_url[s_index_url.size()-1] == '/') s_index_url.erase(s_index_url.size()-1);
+		} else
+		{
+			std::cout << "Unknown option " << option << std::endl;
+			std::cout << "Usage: japkg [-speculative] [-digest] [-crc] [-delta] [-cache <megabytes>] [-keep <versions>] [-index <url>]" << std::endl;
+			return -3;
+		}
+	}
+
 	s_logs_dir = app_dir + "." + s_logs_dir;
 	s_cat_filename = app_dir + "." + s_cat_filename;
 
 	tbx::Path(s_logs_dir).create_directory();
 	std::cout << "Logs directory " << s_logs_dir << std::endl;
 	s_log.start(s_logs_dir, "Packaging run");
+	if (s_speculative) s_log.message("Speculative package creation enabled");
+	if (s_compare_digest) s_log.message("Packages compared using digests");
+	if (s_crc_compare) s_log.message("Files compared using their size and CRC");
 
 	std::cout << "Reading standard copyright text..." << std::flush;
 	s_log.message("Reading copyright text from " + s_copyright_filename);
@@ -111,7 +205,7 @@ int main(int argc, char *argv[0])
 		std::cout << "failed to load" << std::endl;
 		return -1;
 	}
-	s_standard_copyright.assign(cp_text, cp_length);
+	s_standard_copyright = std::make_shared<const std::string>(cp_text, cp_length);
 	delete [] cp_text;
 	std::cout << "loaded" << std::endl;
 	s_log.message("Copyright text loaded");
@@ -130,10 +224,24 @@ int main(int argc, char *argv[0])
 
 	s_log.message("Creating list of current packages");
 	std::cout << "Creating list of current packages..." << std::flush;
-	current_package_list(s_packages_dir + "." + s_release_packages);
-	current_package_list(s_packages_dir + "." + s_beta_packages);
+	if (!current_package_list())
+	{
+		std::cout << "failed" << std::endl;
+		s_log.fatal_error("Unable to read the package directories");
+		return -4;
+	}
 	std::cout << "done" << std::endl;
 	s_log.message(s_current_packages.size(),"current packages found");
+	if (s_keep_versions)
+	{
+		std::cout << "Deleting superseded packages..." << std::flush;
+		prune_packages();
+		std::cout << "done" << std::endl;
+	}
+	for (auto &current : s_current_packages)
+	{
+		s_dependencies.add(current.first, current.second);
+	}
 
 	s_log.message("Creating game to directory mapping");
 	std::cout << "Creating game to directory mapping..." << std::flush;
@@ -148,12 +256,64 @@ int main(int argc, char *argv[0])
 	}
 	***/
 
-	package_extras();
-
 	// Ensure package directories are created
 	tbx::Path(s_packages_dir).create_directory();
 	tbx::Path(s_packages_dir, s_release_packages).create_directory();
 	tbx::Path(s_packages_dir, s_beta_packages).create_directory();
+	if (s_cache_size)
+	{
+		std::string cache_dir(s_packages_dir + "." + s_cache_dirname);
+		s_log.message("Opening compressed file cache " + cache_dir);
+		if (!s_blob_cache.open(cache_dir, (unsigned long long)s_cache_size * 1024 * 1024))
+		{
+			s_log.error("Unable to open compressed file cache " + cache_dir);
+		}
+	}
+	if (s_create_delta)
+	{
+		std::string delta_dir(s_packages_dir + "." + s_delta_dirname);
+		tbx::Path(delta_dir).create_directory();
+		tbx::Path(delta_dir, s_release_packages).create_directory();
+		tbx::Path(delta_dir, s_beta_packages).create_directory();
+	}
+
+	std::string manifest_filename(s_packages_dir + "." + s_manifest_leafname);
+	std::string contents_filename(s_packages_dir + "." + s_contents_leafname);
+	s_log.message("Reading package manifest " + manifest_filename);
+	s_log.message("Reading package contents " + contents_filename);
+	std::cout << "Updating package manifest and contents..." << std::flush;
+	s_manifest.load(manifest_filename);
+	s_contents.load(contents_filename);
+	update_package_dir(s_release_packages);
+	update_package_dir(s_beta_packages);
+	std::cout << s_manifest.size() << " packages" << std::endl;
+	s_log.message(s_manifest.size(), "packages in manifest");
+	s_log.message(s_contents.size(), "packages in contents");
+	if (s_contents.modified() && !s_contents.save(contents_filename))
+	{
+		s_log.error("Failed to save package contents " + contents_filename);
+	}
+
+	std::string index_dir(s_packages_dir + "." + s_index_dirname);
+	std::string index_store_filename(index_dir + "." + s_index_store_leafname);
+	if (!s_index_url.empty())
+	{
+		std::cout << "Updating package index store..." << std::flush;
+		tbx::Path(index_dir).create_directory();
+		if (!s_index.load_store(index_store_filename))
+		{
+			// Start from the last published index if there is no store
+			s_index.load(index_dir + "." + s_release_packages, s_release_packages + ".");
+			s_index.load(index_dir + "." + s_beta_packages, s_beta_packages + ".");
+		}
+		update_index(s_release_packages);
+		update_index(s_beta_packages);
+		std::cout << "done" << std::endl;
+	}
+
+	// Extras use the same stores and cache as the catalogue packages
+	// so they can only be packaged once those are loaded
+	package_extras();
 
 	s_log.message(cat.size(), "packages to check/create");
 	std::cout << "Creating " << cat.size() << " packages" << std::endl;
@@ -164,6 +324,39 @@ int main(int argc, char *argv[0])
 		package_game(entry);
 	}
 
+	check_dependencies();
+
+	if (!s_index_url.empty()
+		&& (s_index.modified() || s_manifest.modified()
+			|| !tbx::Path(index_dir, s_release_packages).exists()
+			|| !tbx::Path(index_dir, s_beta_packages).exists()))
+	{
+		std::cout << "Writing package index..." << std::flush;
+		write_index(s_release_packages);
+		write_index(s_beta_packages);
+		if (!s_index.save_store(index_store_filename))
+		{
+			s_log.error("Failed to save package index store " + index_store_filename);
+		}
+		std::cout << "done" << std::endl;
+	}
+
+	if (s_manifest.modified())
+	{
+		s_log.message("Saving package manifest " + manifest_filename);
+		if (!s_manifest.save(manifest_filename))
+		{
+			s_log.error("Failed to save package manifest " + manifest_filename);
+			std::cout << "Failed to save package manifest " << manifest_filename << std::endl;
+		}
+	}
+
+	if (s_blob_cache.is_open())
+	{
+		s_blob_cache.close();
+		s_log.cache_statistics(s_blob_cache.hits(), s_blob_cache.misses(), s_blob_cache.evicted());
+	}
+
 	s_log.end("End of packaging");
 
 	return 0;
@@ -209,6 +402,8 @@ void package_extra(const std::string &extra_dir)
 	delete [] data;
 
 	Packager pkg;
+	pkg.lazy_validation(true);
+	pkg.crc_compare(s_crc_compare);
 	pkg.package_name(pkgname);
 	try
 	{
@@ -231,7 +426,7 @@ void package_extra(const std::string &extra_dir)
 
 
 
-	pkg.copyright(copyright);
+	pkg.copyright(std::move(copyright));
 	std::string version = pkg.version();
 	if (!version.empty() && version[0] == '{')
 	{
@@ -373,6 +568,8 @@ void package_game(const CatEntry &entry)
 	}
 
 	Packager pkg;
+	pkg.lazy_validation(true);
+	pkg.crc_compare(s_crc_compare);
 
 	if (has_control)
 	{
@@ -407,9 +604,7 @@ void package_game(const CatEntry &entry)
 	pkg.maintainer(s_maintainer);
 	pkg.licence("Non free");
 
-	std::string copyright(full_name);
-	copyright += "\n\n" + s_standard_copyright;
-	pkg.copyright(copyright);
+	pkg.copyright(full_name + "\n\n", s_standard_copyright);
 
 	for (const std::string &fsobject : game_dir_list)
 	{
@@ -448,7 +643,9 @@ void package_game(const CatEntry &entry)
 void check_and_save_package(Packager &pkg, Log::PackageContext &log_context, bool released)
 {
 	std::string pkgname(pkg.package_name());
+	pkg.blob_cache(&s_blob_cache);
 	// Check package for validity
+	pkg.validate();
     if (pkg.error_count())
     {
     	std::cout << "Invalid package" << std::endl;
@@ -467,6 +664,9 @@ void check_and_save_package(Packager &pkg, Log::PackageContext &log_context, boo
     } else
     {
     	bool save_package = true;
+    	bool promote_beta = false;
+    	std::string lastpkgfile;
+    	std::string previous_pkgfile;
     	auto current = s_current_packages.find(pkgname);
     	if (current == s_current_packages.end())
     	{
@@ -477,18 +677,22 @@ void check_and_save_package(Packager &pkg, Log::PackageContext &log_context, boo
     	{
     		try
     		{
-				pkg::version v(pkg.version() + "-" + pkg.package_version());
-				pkg::version old_v(current->second);
-				if (v > old_v)
+				if (VersionKey::intern(pkg.version() + "-" + pkg.package_version())
+						> VersionKey::intern(current->second))
 				{
 					std::cout << "upgrade (new version)";
 					log_context.message("Upgrading due to new version");
+					std::string previous_leafname(pkgname + "_" + current->second);
+					std::string::size_type dot_pos;
+					while ((dot_pos = previous_leafname.find('.')) != std::string::npos) previous_leafname[dot_pos] = '/';
+					previous_pkgfile = s_packages_dir + "." + (released ? s_release_packages : s_beta_packages) + "." + previous_leafname;
 				} else
 				{
 					// Use old version - will increase later
+					pkg::version old_v(current->second);
 					pkg.version(old_v.upstream_version());
 					pkg.package_version(old_v.package_version());
-    				std::string lastpkgfile(s_packages_dir + "." + s_release_packages + "." + pkg.standard_leafname());
+    				lastpkgfile = s_packages_dir + "." + s_release_packages + "." + pkg.standard_leafname();
     			    save_package = false;
     				if (!tbx::Path(lastpkgfile).exists())
     				{
@@ -498,14 +702,78 @@ void check_and_save_package(Packager &pkg, Log::PackageContext &log_context, boo
     						log_context.message("Upgrading beta to release");
     						std::cout << "upgrade (beta to release)";
     						save_package = true;
+
+    						// Files can be copied from the beta if they haven't changed
+    						const PackageFileContents *beta_contents = s_contents.find(lastpkgfile.substr(s_packages_dir.size() + 1));
+    						std::string diff;
+    						if (beta_contents && pkg.same_files_as(beta_contents->files, lastpkgfile, &diff))
+    						{
+    							log_context.message("Files are the same as the beta package so will be copied from it");
+    							promote_beta = true;
+    						}
     					}
     				}
 
     				if (!save_package)
 					{
-    					log_context.message("Comparing files with last package");
     					std::string diff;
-						save_package = !pkg.same_as(lastpkgfile, &diff);
+    					if (s_compare_digest)
+    					{
+    						log_context.message("Comparing package digest with last package");
+    						const PackageDigests *last_digests = s_manifest.find(lastpkgfile.substr(s_packages_dir.size() + 1));
+    						if (last_digests) save_package = !pkg.same_digest(last_digests->sha256, &diff);
+    						else save_package = !pkg.same_digest_as(lastpkgfile, &diff);
+    					} else if (s_speculative)
+    					{
+    						log_context.message("Comparing control record and copyright with last package");
+    						std::string lastname(lastpkgfile.substr(s_packages_dir.size() + 1));
+    						const PackageDigests *last_digests = s_manifest.find(lastname);
+    						const PackageFileContents *last_contents = s_contents.find(lastname);
+    						// Matching fingerprints are only trusted with -crc. Fingerprints
+    						// that differ are checked against the package in case they were
+    						// recorded by an older version
+    						bool same_metadata = (s_crc_compare && last_digests && last_digests->has_fingerprints()
+    								&& pkg.same_fingerprints(*last_digests, &diff));
+    						if (!same_metadata)
+    						{
+    							if (last_contents) same_metadata = pkg.same_metadata_as(last_contents->files, lastpkgfile, &diff);
+    							else same_metadata = pkg.same_metadata_as(lastpkgfile, &diff);
+    							if (same_metadata) record_fingerprints(lastname, pkg);
+    						}
+    						if (same_metadata)
+    						{
+    							speculative_save(pkg, log_context, released, lastpkgfile);
+    							return;
+    						}
+    						save_package = true;
+    					} else
+    					{
+    						log_context.message("Comparing files with last package");
+    						std::string lastname(lastpkgfile.substr(s_packages_dir.size() + 1));
+    						const PackageDigests *last_digests = s_manifest.find(lastname);
+    						const PackageFileContents *last_contents = s_contents.find(lastname);
+    						if (s_crc_compare && last_digests && last_digests->has_fingerprints()
+    							&& pkg.same_fingerprints(*last_digests, &diff))
+    						{
+    							// Control record and copyright checked without reading the package
+    							// as -crc accepts a matching hash in place of the contents
+    							if (last_contents) save_package = !pkg.same_files_as(last_contents->files, lastpkgfile, &diff);
+    							else save_package = !pkg.same_as(lastpkgfile, &diff);
+    						} else
+    						{
+    							// Without -crc, or if the fingerprints differ as they may have
+    							// been recorded by an older version, the package is checked
+    							if (last_contents) save_package = !pkg.same_as(last_contents->files, lastpkgfile, &diff);
+    							else save_package = !pkg.same_as(lastpkgfile, &diff);
+    							if (!save_package) record_fingerprints(lastname, pkg);
+    						}
+    						if (pkg.file_tree().built())
+    						{
+    							// Same files are used for the save if the package is upgraded
+    							log_context.message(tbx::to_string(pkg.file_tree().size()) + " files, "
+    									+ tbx::to_string(pkg.file_tree().total_length()) + " bytes read from disc");
+    						}
+    					}
 						if (save_package)
 						{
 							std::cout << "upgrade (" << diff << ")";
@@ -514,6 +782,7 @@ void check_and_save_package(Packager &pkg, Log::PackageContext &log_context, boo
 					}
     				if (save_package)
     				{
+    					previous_pkgfile = lastpkgfile;
     					// Update version for new release
     					int new_pv = tbx::from_string<int>(pkg.package_version())+1;
     					pkg.package_version(tbx::to_string(new_pv));
@@ -549,10 +818,18 @@ void check_and_save_package(Packager &pkg, Log::PackageContext &log_context, boo
 
 			log_context.message("Creating/saving package to " + pkgfile);
 			std::string errmsg;
-			if (pkg.save(pkgfile, &errmsg))
+			PackageDigests digests;
+			bool saved;
+			if (promote_beta) saved = pkg.promote(lastpkgfile, pkgfile, &errmsg, &digests);
+			else saved = pkg.save(pkgfile, &errmsg, &digests);
+			if (saved)
 			{
+				s_manifest.set(type + "." + pkg.standard_leafname(), digests);
+				index_package(pkgfile, pkg);
+				add_dependencies(pkg);
 				log_context.message("Created/saved");
 				std::cout << "created ";
+				if (!promote_beta) create_delta(previous_pkgfile, pkgfile, type, log_context);
 			} else
 			{
 				log_context.error("Failed to save/create - " + errmsg);
@@ -561,43 +838,427 @@ void check_and_save_package(Packager &pkg, Log::PackageContext &log_context, boo
 			std::cout << type << " package " << pkgfile << std::endl;
     	} else
     	{
+    		index_package(lastpkgfile, pkg);
+    		add_dependencies(pkg);
     		std::cout << "is up to date" << std::endl;
     		log_context.message("Package is up to date");
     	}
     }
 }
 
+/**
+ * Create the next version of a package while comparing its files
+ * with the last package.
+ *
+ * Files that are the same as in the last package are copied from it
+ * once a difference is found, so the files are only read from disc once
+ * for a package that has changed. A package that has not changed is
+ * never built and the package version is left unchanged.
+ *
+ * The package is built to a temporary file and moved into place once
+ * it is complete.
+ *
+ * @param pkg package to save
+ * @param log_context package context
+ * @param released - released build
+ * @param lastpkgfile last package created with the same version
+ */
+void speculative_save(Packager &pkg, Log::PackageContext &log_context, bool released, const std::string &lastpkgfile)
+{
+	std::string last_package_version(pkg.package_version());
+	int new_pv = tbx::from_string<int>(last_package_version)+1;
+	pkg.package_version(tbx::to_string(new_pv));
+
+	std::string type(released ? s_release_packages : s_beta_packages);
+	std::string pkgfile(s_packages_dir + "." + type + "." + pkg.standard_leafname());
+	std::string tempfile(s_packages_dir + "." + s_speculative_leafname);
+
+	std::cout << "..." << std::flush;
+	log_context.message("Comparing files with last package while creating next version in " + tempfile);
+	const PackageFileContents *last_contents = s_contents.find(lastpkgfile.substr(s_packages_dir.size() + 1));
+	std::string errmsg, diff;
+	PackageDigests digests;
+	bool changed;
+	if (!pkg.save_if_changed(tempfile, lastpkgfile, last_contents ? &last_contents->files : nullptr,
+			changed, &diff, &errmsg, &digests))
+	{
+		std::remove(tempfile.c_str());
+		pkg.package_version(last_package_version);
+		log_context.error("Failed to save/create - " + errmsg);
+		std::cout << "failed to create " << type << " package " << pkgfile << std::endl;
+		return;
+	}
+
+	if (!changed)
+	{
+		pkg.package_version(last_package_version);
+		index_package(lastpkgfile, pkg);
+		add_dependencies(pkg);
+		std::cout << "is up to date" << std::endl;
+		log_context.message("Package is up to date");
+		return;
+	}
+
+	std::cout << "upgrade (" << diff << ") ";
+	log_context.message("Upgrading " + diff);
+	log_context.upgrade_package(true);
+
+	log_context.message("Moving package to " + pkgfile);
+	if (std::rename(tempfile.c_str(), pkgfile.c_str()) == 0)
+	{
+		s_manifest.set(type + "." + pkg.standard_leafname(), digests);
+		index_package(pkgfile, pkg);
+		add_dependencies(pkg);
+		log_context.message("Created/saved");
+		std::cout << "created ";
+		create_delta(lastpkgfile, pkgfile, type, log_context);
+	} else
+	{
+		std::remove(tempfile.c_str());
+		log_context.error("Failed to save/create - unable to rename " + tempfile);
+		std::cout << "failed to create ";
+	}
+	std::cout << type << " package " << pkgfile << std::endl;
+}
+
+/**
+ * Create a delta from the previous version of a package if deltas are
+ * turned on and the previous version is in the same package directory.
+ *
+ * The delta is checked by rebuilding the new package from it and is
+ * deleted if the rebuilt package isn't identical.
+ *
+ * @param previous_pkgfile full path of the previous version of the package or ""
+ * @param pkgfile full path of the new version of the package
+ * @param type package type which is also the name of the directory
+ * @param log_context package context
+ */
+void create_delta(const std::string &previous_pkgfile, const std::string &pkgfile, const std::string &type, Log::PackageContext &log_context)
+{
+	if (!s_create_delta || previous_pkgfile.empty()) return;
+	std::string pkgdir(s_packages_dir + "." + type + ".");
+	if (previous_pkgfile.compare(0, pkgdir.size(), pkgdir) != 0
+		|| !tbx::Path(previous_pkgfile).exists())
+	{
+		return;
+	}
+
+	std::string delta_file(s_packages_dir + "." + s_delta_dirname + "." + type + "." + tbx::Path(pkgfile).leaf_name());
+	log_context.message("Creating delta " + delta_file + " from " + previous_pkgfile);
+	std::string errmsg;
+	if (!PackageDelta::create(previous_pkgfile, pkgfile, delta_file, &errmsg))
+	{
+		log_context.error("Failed to create delta - " + errmsg);
+		return;
+	}
+	if (!PackageDelta::verify(previous_pkgfile, pkgfile, delta_file, &errmsg))
+	{
+		std::remove(delta_file.c_str());
+		log_context.message("Delta deleted - " + errmsg);
+		return;
+	}
+	log_context.message("Delta created");
+}
+
 /**
  * Create list of current packages and the latest packaged version
+ * from the versions of the packages in the release and beta directories.
  *
- * @param from_dir - packages from the given directory are added
- *                   to the list
+ * @returns false if a package directory could not be read
  */
-void current_package_list(const std::string &from_dirname)
+bool current_package_list()
 {
-	tbx::Path package_dir(from_dirname);
-	// Missing directory
-	if (!package_dir.directory()) return;
-
-	for (std::string &fsobject : package_dir)
-	{
-		std::string::size_type us_pos = fsobject.rfind('_');
-		if (us_pos != std::string::npos)
-		{
-			std::string pkgname = fsobject.substr(0,us_pos);
-			std::string ver = fsobject.substr(us_pos+1);
-			// Convert slashes back to dots for version
-			std::string::size_type slash_pos;
-			while ((slash_pos = ver.find("/")) != std::string::npos) ver[slash_pos] = '.';
-			auto found = s_current_packages.find(pkgname);
-			if (found == s_current_packages.end()
-				|| pkg::version(ver) > pkg::version(found->second) )
+	std::vector<std::string> invalid_release, invalid_beta;
+	bool ok = s_versions.scan(s_packages_dir + "." + s_release_packages, s_release_packages, &invalid_release)
+		&& s_versions.scan(s_packages_dir + "." + s_beta_packages, s_beta_packages, &invalid_beta);
+	for (const std::string &leafname : invalid_release)
+	{
+		s_log.error("Invalid version in package file " + s_release_packages + "." + leafname + ", file ignored");
+	}
+	for (const std::string &leafname : invalid_beta)
+	{
+		s_log.error("Invalid version in package file " + s_beta_packages + "." + leafname + ", file ignored");
+	}
+	if (!ok) return false;
+	for (auto &package : s_versions)
+	{
+		s_current_packages[package.first] = package.second.front().version->text();
+	}
+
+	return true;
+}
+
+/**
+ * Delete the package files older than the number of versions to keep
+ * in each package directory along with their deltas.
+ *
+ * The newest version of each package is never deleted.
+ */
+void prune_packages()
+{
+	std::vector<PackageVersions::Entry> old_entries;
+	s_versions.superseded(s_keep_versions, old_entries);
+
+	size_t count = 0;
+	for (const PackageVersions::Entry &entry : old_entries)
+	{
+		std::string name(entry.type + "." + entry.leafname);
+		std::string pkgfile(s_packages_dir + "." + name);
+		if (std::remove(pkgfile.c_str()) == 0)
+		{
+			s_log.message("Deleted superseded package " + name);
+			std::string delta_file(s_packages_dir + "." + s_delta_dirname + "." + name);
+			std::remove(delta_file.c_str());
+			s_versions.remove(entry);
+			count++;
+		} else
+		{
+			s_log.error("Unable to delete superseded package " + name);
+		}
+	}
+	s_log.message(count, "superseded packages deleted");
+}
+
+/**
+ * Bring the manifest and contents up to date with the packages in a directory.
+ *
+ * Packages that are new or whose size or date stamp has changed have
+ * their digests calculated and their contents read. Packages that have been deleted are removed from both.
+ *
+ * @param type package type which is also the name of the directory
+ */
+void update_package_dir(const std::string &type)
+{
+	std::string prefix(type + ".");
+	std::string dirname(s_packages_dir + "." + type);
+	std::set<std::string> found;
+
+	DirScan scan(dirname);
+	while (scan.next())
+	{
+		if (scan.object_type() != DirScan::OT_FILE) continue;
+		std::string name(prefix + scan.name());
+		std::string filename(s_packages_dir + "." + name);
+		found.insert(name);
+		const PackageDigests *current = s_manifest.find(name);
+		if (!current || current->changed(scan.length(), scan.load_address(), scan.exec_address()))
+		{
+			// Fingerprints are cleared as the package may no longer be
+			// the one they were recorded for
+			PackageDigests digests;
+			if (digests.calculate(filename))
 			{
-//				std::cout << "Found " << pkgname << " " << ver << std::endl;
-				s_current_packages[pkgname] = ver;
+				s_manifest.set(name, digests);
+			} else
+			{
+				s_log.error("Unable to read package " + name + " for manifest");
 			}
+		} else if (!current->has_stamp())
+		{
+			// Record the date stamp for entries from older manifests
+			PackageDigests digests(*current);
+			digests.load_address = scan.load_address();
+			digests.exec_address = scan.exec_address();
+			s_manifest.set(name, digests);
+		}
+		if (!s_contents.update(name, filename, scan.length(), scan.load_address(), scan.exec_address()))
+		{
+			s_log.error("Unable to read contents of package " + name);
+		}
+	}
+	if (scan.error())
+	{
+		// Packages not found may still exist so must be kept
+		s_log.error("Unable to read package directory " + dirname + ", deleted packages not removed from manifest and contents");
+		return;
+	}
+
+	std::vector<std::string> removed;
+	for (auto &entry : s_manifest)
+	{
+		if (entry.first.compare(0, prefix.size(), prefix) == 0
+			&& found.find(entry.first) == found.end())
+		{
+			removed.push_back(entry.first);
 		}
 	}
+	for (const std::string &name : removed) s_manifest.remove(name);
+
+	removed.clear();
+	for (auto entry = s_contents.lower_bound(prefix);
+		entry != s_contents.end() && entry->first.compare(0, prefix.size(), prefix) == 0;
+		++entry)
+	{
+		if (found.find(entry->first) == found.end()) removed.push_back(entry->first);
+	}
+	for (const std::string &name : removed) s_contents.remove(name);
+}
+
+/**
+ * Record the fingerprints of the control record and copyright for a
+ * package in the manifest once they have been checked against it.
+ *
+ * @param name name of the package relative to the packages directory
+ * @param pkg package with the same control record and copyright
+ */
+void record_fingerprints(const std::string &name, const Packager &pkg)
+{
+	const PackageDigests *current = s_manifest.find(name);
+	if (!current) return;
+	unsigned long long control_fingerprint = pkg.control_fingerprint();
+	unsigned long long copyright_fingerprint = pkg.copyright_fingerprint();
+	if (current->has_fingerprints()
+		&& current->control_fingerprint == control_fingerprint
+		&& current->copyright_fingerprint == copyright_fingerprint)
+	{
+		return;
+	}
+
+	PackageDigests digests(*current);
+	digests.control_fingerprint = control_fingerprint;
+	digests.copyright_fingerprint = copyright_fingerprint;
+	digests.fingerprints_known = true;
+	s_manifest.set(name, digests);
+}
+
+/**
+ * Record the control record of a package for the index
+ *
+ * @param pkgfile full name of the package file
+ * @param pkg package it was created from
+ */
+void index_package(const std::string &pkgfile, const Packager &pkg)
+{
+	if (s_index_url.empty()) return;
+	s_index.set(pkgfile.substr(s_packages_dir.size() + 1), pkg.control_as_text());
+}
+
+/**
+ * Add a package that has been created or is up to date to the
+ * dependency graph
+ *
+ * @param pkg package with its final version
+ */
+void add_dependencies(const Packager &pkg)
+{
+	s_dependencies.add(pkg.package_name(),
+			pkg.version() + "-" + pkg.package_version(),
+			pkg.dependencies(DEPENDS));
+}
+
+/**
+ * Check the dependencies of all the packages can be satisfied
+ * by the packages that have been created.
+ */
+void check_dependencies()
+{
+	std::cout << "Checking package dependencies..." << std::flush;
+	std::vector<std::string> problems;
+	s_dependencies.check(problems);
+	for (const std::string &problem : problems)
+	{
+		s_log.error(problem);
+	}
+	s_log.message(problems.size(), "dependency problems found");
+	std::cout << problems.size() << " problems found" << std::endl;
+}
+
+/**
+ * Bring the index store up to date with the packages in a directory.
+ *
+ * Only the directory is read to find packages that have been added
+ * or deleted. Packages that are not in the store have their control
+ * record read from the package file.
+ *
+ * @param type package type which is also the name of the directory
+ */
+void update_index(const std::string &type)
+{
+	std::string prefix(type + ".");
+	std::set<std::string> found;
+	int zip_reads = 0;
+	Packager reader;
+
+	DirScan scan(s_packages_dir + "." + type);
+	while (scan.next())
+	{
+		if (scan.object_type() != DirScan::OT_FILE) continue;
+		std::string name(prefix + scan.name());
+		found.insert(name);
+		if (!s_index.find(name))
+		{
+			std::string control;
+			if (reader.read_zip_item(s_packages_dir + "." + name, "RiscPkg/Control", control))
+			{
+				s_index.set(name, control);
+				zip_reads++;
+			} else
+			{
+				s_log.error("Unable to read control record from package " + name + " for index");
+			}
+		}
+	}
+	if (scan.error())
+	{
+		// Packages not found may still exist so must be kept
+		s_log.error("Unable to read package directory " + s_packages_dir + "." + type + ", deleted packages not removed from index store");
+		s_log.message(zip_reads, "packages added to " + type + " index store");
+		return;
+	}
+
+	std::vector<std::string> removed;
+	for (auto entry = s_index.lower_bound(prefix);
+		entry != s_index.end() && entry->first.compare(0, prefix.size(), prefix) == 0;
+		++entry)
+	{
+		if (found.find(entry->first) == found.end()) removed.push_back(entry->first);
+	}
+	for (const std::string &name : removed) s_index.remove(name);
+
+	s_log.message(zip_reads, "packages added to " + type + " index store");
+	s_log.message(removed.size(), "packages removed from " + type + " index store");
+}
+
+/**
+ * Write the RiscPkg index for a package directory from the index store.
+ *
+ * Sizes and MD5 sums come from the manifest.
+ *
+ * @param type package type which is also the name of the directory
+ */
+void write_index(const std::string &type)
+{
+	std::string prefix(type + ".");
+	std::string filename(s_packages_dir + "." + s_index_dirname + "." + type);
+
+	std::ofstream index(filename.c_str());
+	if (!index)
+	{
+		s_log.error("Unable to create package index " + filename);
+		return;
+	}
+
+	int count = 0;
+	for (auto entry = s_index.lower_bound(prefix);
+		entry != s_index.end() && entry->first.compare(0, prefix.size(), prefix) == 0;
+		++entry)
+	{
+		const PackageDigests *digests = s_manifest.find(entry->first);
+		if (!digests)
+		{
+			s_log.error("Package " + entry->first + " not indexed as it is not in the manifest");
+			continue;
+		}
+
+		// URLs use the unix form of the file name
+		std::string url_leafname(entry->first, prefix.size());
+		std::string::size_type slash_pos;
+		while ((slash_pos = url_leafname.find('/')) != std::string::npos) url_leafname[slash_pos] = '.';
+		PackageIndex::write_record(index, entry->second, *digests, s_index_url + "/" + type + "/" + url_leafname);
+		count++;
+	}
+
+	s_log.message(count, "packages in " + type + " index");
 }
 
 /**
@@ -605,9 +1266,10 @@ void current_package_list(const std::string &from_dirname)
  */
 void create_dir_lookup()
 {
-	tbx::Path games_dir(s_games_dir);
-	for (std::string &fsobject : games_dir)
+	DirScan scan(s_games_dir);
+	while (scan.next())
 	{
+		std::string fsobject(scan.name());
 		std::string::size_type cv_pos = fsobject.rfind(HARD_SPACE);
 		if (cv_pos != std::string::npos)
 		{
@@ -618,6 +1280,7 @@ void create_dir_lookup()
 			}
 		}
 	}
+	if (scan.error()) s_log.error("Unable to read all of the games directory " + s_games_dir);
 }
 
 /**
@@ -229,7 +229,7 @@ version::operator string() const
 	if (include_minus)
 	{
 		verstr.push_back('-');
-		verstr.append(_upstream_version);
+		verstr.append(_package_version);
 	}
 	return verstr;
 }